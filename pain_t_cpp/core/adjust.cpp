@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "adjust.h"
+#include "blend.h"
+#include "parallel.h"
+
+static void 
+rgbToHsl(float r, float g, float b, float& h, float& s, float& l){
+    float mx = std::max({r, g, b}), mn = std::min({r, g, b});
+    l = (mx + mn) * 0.5f;
+    if (mx == mn){h = s = 0.0f; return;}
+
+    float d = mx - mn;
+    s = l > 0.5f ? d / (2.0f - mx - mn) : d / (mx + mn);
+    if (mx == r) h = (g - b) / d + (g < b ? 6.0f : 0.0f);
+    else if (mx == g) h = (b - r) / d + 2.0f;
+    else h = (r - g) / d + 4.0f;
+    h /= 6.0f;
+}
+
+static float 
+hueToRgb(float p, float q, float t){
+    if (t < 0.0f) t += 1.0f;
+    if (t > 1.0f) t -= 1.0f;
+    if (t < 1.0f / 6.0f) return p + (q - p) * 6.0f * t;
+    if (t < 0.5f) return q;
+    if (t < 2.0f / 3.0f) return p + (q - p) * (2.0f / 3.0f - t) * 6.0f;
+    return p;
+}
+
+static void 
+hslToRgb(float h, float s, float l, float& r, float& g, float& b){
+    if (s <= 0.0f){r = g = b = l; return;}
+    float q = l < 0.5f ? l * (1.0f + s) : l + s - l * s;
+    float p = 2.0f * l - q;
+    r = hueToRgb(p, q, h + 1.0f / 3.0f);
+    g = hueToRgb(p, q, h);
+    b = hueToRgb(p, q, h - 1.0f / 3.0f);
+}
+
+Adjustment::Adjustment(const AdjustParams& p){
+    float lo = std::clamp(p.levelsLow, 0, 254);
+    float hi = std::clamp(p.levelsHigh, static_cast<int>(lo) + 1, 255);
+    float gamma = std::max(p.gamma, 0.01f);
+    float bright = p.brightness * 2.55f;
+    float c = std::clamp(p.contrast, -100, 100) * 2.55f;
+    float contrast = (259.0f * (c + 255.0f)) / (255.0f * (259.0f - c));
+
+    for (int i = 0; i < 256; ++i){
+        float v = std::clamp((i - lo) / (hi - lo), 0.0f, 1.0f);
+        v = std::pow(v, 1.0f / gamma) * 255.0f;
+        v = contrast * (v + bright - 128.0f) + 128.0f;
+        pre[i] = static_cast<uint8_t>(std::clamp(v + 0.5f, 0.0f, 255.0f));
+        post[i] = p.invert ? static_cast<uint8_t>(255 - i) : static_cast<uint8_t>(i);
+    }
+    for (int i = 0; i < 256; ++i) both[i] = post[pre[i]];
+
+    hasCube = (p.hue != 0 || p.saturation != 0);
+    if (!hasCube) return;
+
+    float shift = p.hue / 360.0f;
+    float sat = 1.0f + std::clamp(p.saturation, -100, 100) / 100.0f;
+    cube.resize(CUBE * CUBE * CUBE * 4);
+    for (int r = 0; r < CUBE; ++r)
+        for (int g = 0; g < CUBE; ++g)
+            for (int b = 0; b < CUBE; ++b){
+                float h, s, l, nr, ng, nb;
+                rgbToHsl(r / float(CUBE - 1), g / float(CUBE - 1), b / float(CUBE - 1), h, s, l);
+                h = h + shift - std::floor(h + shift);
+                hslToRgb(h, std::clamp(s * sat, 0.0f, 1.0f), l, nr, ng, nb);
+
+                float* e = &cube[((r * CUBE + g) * CUBE + b) * 4];
+                e[0] = nb * 255.0f; e[1] = ng * 255.0f; e[2] = nr * 255.0f; e[3] = 0.0f;
+            }
+}
+
+//trilinear lookup, the three colour channels ride in one SSE register
+uint32_t 
+Adjustment::applyCube(uint32_t rgb) const{
+    const float scale = (CUBE - 1) / 255.0f;
+    float fr = ((rgb >> 16) & 0xFF) * scale;
+    float fg = ((rgb >> 8) & 0xFF) * scale;
+    float fb = (rgb & 0xFF) * scale;
+    int r0 = std::min(static_cast<int>(fr), CUBE - 2);
+    int g0 = std::min(static_cast<int>(fg), CUBE - 2);
+    int b0 = std::min(static_cast<int>(fb), CUBE - 2);
+    float tr = fr - r0, tg = fg - g0, tb = fb - b0;
+
+    auto at = [&](int r, int g, int b){return &cube[((r * CUBE + g) * CUBE + b) * 4];};
+
+#ifdef __SSE2__
+    auto lerp = [](__m128 a, __m128 b, float t){
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(t)));
+    };
+    __m128 c00 = lerp(_mm_loadu_ps(at(r0, g0, b0)),         _mm_loadu_ps(at(r0, g0, b0 + 1)), tb);
+    __m128 c01 = lerp(_mm_loadu_ps(at(r0, g0 + 1, b0)),     _mm_loadu_ps(at(r0, g0 + 1, b0 + 1)), tb);
+    __m128 c10 = lerp(_mm_loadu_ps(at(r0 + 1, g0, b0)),     _mm_loadu_ps(at(r0 + 1, g0, b0 + 1)), tb);
+    __m128 c11 = lerp(_mm_loadu_ps(at(r0 + 1, g0 + 1, b0)), _mm_loadu_ps(at(r0 + 1, g0 + 1, b0 + 1)), tb);
+    __m128 c = lerp(lerp(c00, c01, tg), lerp(c10, c11, tg), tr);
+
+    __m128i i = _mm_cvtps_epi32(c);
+    i = _mm_packs_epi32(i, i);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(i, i))) & 0x00FFFFFF;
+#else
+    uint32_t out = 0;
+    for (int k = 0; k < 3; ++k){
+        auto lerp = [](float a, float b, float t){return a + (b - a) * t;};
+        float c00 = lerp(at(r0, g0, b0)[k],         at(r0, g0, b0 + 1)[k], tb);
+        float c01 = lerp(at(r0, g0 + 1, b0)[k],     at(r0, g0 + 1, b0 + 1)[k], tb);
+        float c10 = lerp(at(r0 + 1, g0, b0)[k],     at(r0 + 1, g0, b0 + 1)[k], tb);
+        float c11 = lerp(at(r0 + 1, g0 + 1, b0)[k], at(r0 + 1, g0 + 1, b0 + 1)[k], tb);
+        float v = lerp(lerp(c00, c01, tg), lerp(c10, c11, tg), tr);
+        out |= static_cast<uint32_t>(std::clamp(v + 0.5f, 0.0f, 255.0f)) << (8 * k);
+    }
+    return out;
+#endif
+}
+
+uint32_t 
+Adjustment::applyPixel(uint32_t px) const{
+    uint32_t a = px >> 24;
+    if (a == 0) return px;
+
+    //tables work on straight colour
+    uint32_t r = (px >> 16) & 0xFF, g = (px >> 8) & 0xFF, b = px & 0xFF;
+    if (a != 255){
+        r = std::min<uint32_t>(255, (r * 255 + a / 2) / a);
+        g = std::min<uint32_t>(255, (g * 255 + a / 2) / a);
+        b = std::min<uint32_t>(255, (b * 255 + a / 2) / a);
+    }
+
+    uint32_t rgb;
+    if (hasCube){
+        rgb = applyCube((uint32_t(pre[r]) << 16) | (uint32_t(pre[g]) << 8) | pre[b]);
+        rgb = (uint32_t(post[(rgb >> 16) & 0xFF]) << 16) | (uint32_t(post[(rgb >> 8) & 0xFF]) << 8) | post[rgb & 0xFF];
+    } else{
+        rgb = (uint32_t(both[r]) << 16) | (uint32_t(both[g]) << 8) | both[b];
+    }
+    return premultiply((a << 24) | rgb);
+}
+
+void 
+Adjustment::applySpan(const uint32_t* src, uint32_t* dst, int n) const{
+    for (int i = 0; i < n; ++i)
+        dst[i] = applyPixel(src[i]);
+}
+
+void 
+Adjustment::apply(Canvas& canvas, const Selection* selection) const{
+    int w = canvas.getWidth();
+    int h = canvas.getHeight();
+    uint32_t* pixels = canvas.getPixels().data();
+
+    parallelFor(0, h, 64, [&](int y0, int y1){
+        for (int y = y0; y < y1; ++y){
+            uint32_t* row = pixels + static_cast<size_t>(y) * w;
+            auto run = [&](int a, int b){applySpan(row + a, row + a, b - a);};
+            if (selection) selection->clipSpan(y, 0, w, run);
+            else run(0, w);
+        }
+    });
+    canvas.markAllDirty();
+}
@@ -0,0 +1,46 @@
+#ifndef ADJUST_H
+#define ADJUST_H
+
+#include <cstdint>
+#include <vector>
+
+#include "canvas.h"
+#include "selection.h"
+
+struct AdjustParams{
+    int brightness = 0;     //-100..100
+    int contrast = 0;       //-100..100
+    int levelsLow = 0;      //input black point
+    int levelsHigh = 255;   //input white point
+    float gamma = 1.0f;
+    int hue = 0;            //degrees, -180..180
+    int saturation = 0;     //-100..100
+    bool invert = false;
+};
+
+//Colour adjustment compiled into lookup tables: 256-entry curves for the
+//per-channel parts and a 17^3 RGB cube (trilinear) for hue/saturation.
+//Pixels only ever do table lookups, whatever the parameters are.
+class Adjustment{
+public:
+    explicit Adjustment(const AdjustParams& p);
+
+    void applySpan(const uint32_t* src, uint32_t* dst, int n) const;
+
+    //full resolution, row bands in parallel, clipped to the selection
+    void apply(Canvas& canvas, const Selection* selection = nullptr) const;
+
+private:
+    static constexpr int CUBE = 17;
+
+    uint32_t applyPixel(uint32_t px) const;
+    uint32_t applyCube(uint32_t rgb) const;
+
+    uint8_t pre[256];       //levels, brightness, contrast
+    uint8_t post[256];      //invert
+    uint8_t both[256];      //post(pre(x)), used when there is no cube
+    bool hasCube = false;
+    std::vector<float> cube;    //CUBE^3 entries of (r, g, b, pad)
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#include "adjust_tool.h"
+
+AdjustTool::AdjustTool(const Canvas& source)
+    : factor(std::max(1, (std::max(source.getWidth(), source.getHeight()) + PROXY_MAX - 1) / PROXY_MAX)),
+      proxySource((source.getWidth() + factor - 1) / factor, (source.getHeight() + factor - 1) / factor, MemCategory::Previews),
+      proxy(proxySource.getWidth(), proxySource.getHeight(), MemCategory::Previews)
+{
+    //box-average the layer down once, every preview works from this copy
+    int sw = source.getWidth(), sh = source.getHeight();
+    const uint32_t* src = source.getPixels().data();
+    uint32_t* dst = proxySource.getPixels().data();
+
+    for (int py = 0; py < proxySource.getHeight(); ++py){
+        for (int px = 0; px < proxySource.getWidth(); ++px){
+            uint32_t sum[4] = {0, 0, 0, 0};
+            int count = 0;
+            for (int y = py * factor; y < std::min(sh, (py + 1) * factor); ++y){
+                for (int x = px * factor; x < std::min(sw, (px + 1) * factor); ++x){
+                    uint32_t p = src[static_cast<size_t>(y) * sw + x];
+                    for (int c = 0; c < 4; ++c) sum[c] += (p >> (8 * c)) & 0xFF;
+                    ++count;
+                }
+            }
+            uint32_t out = 0;
+            for (int c = 0; c < 4; ++c) out |= ((sum[c] + count / 2) / count) << (8 * c);
+            dst[py * proxySource.getWidth() + px] = out;
+        }
+    }
+    renderProxy();
+}
+
+void 
+AdjustTool::setParams(const AdjustParams& p){
+    params = p;
+    renderProxy();
+}
+
+void 
+AdjustTool::renderProxy(){
+    Adjustment adj(params);
+    int pw = proxy.getWidth();
+    const uint32_t* src = proxySource.getPixels().data();
+    uint32_t* dst = proxy.getPixels().data();
+
+    for (int y = 0; y < proxy.getHeight(); ++y){
+        const uint32_t* in = src + static_cast<size_t>(y) * pw;
+        uint32_t* out = dst + static_cast<size_t>(y) * pw;
+        std::copy_n(in, pw, out);
+
+        //selection sampled at proxy resolution, good enough for a preview
+        auto run = [&](int a, int b){adj.applySpan(in + a, out + a, b - a);};
+        if (!selection || !selection->isActive()){
+            run(0, pw);
+            continue;
+        }
+        int x = 0;
+        while (x < pw){
+            bool inside = selection->contains(x * factor, y * factor);
+            int end = x + 1;
+            while (end < pw && selection->contains(end * factor, y * factor) == inside) ++end;
+            if (inside) run(x, end);
+            x = end;
+        }
+    }
+}
+
+void 
+AdjustTool::drawOverlay(cairo_t* cr){
+    if (cancelled || applied) return;
+
+    cairo_surface_t* surface = cairo_image_surface_create_for_data(
+        reinterpret_cast<unsigned char*>(proxy.getPixels().data()),
+        CAIRO_FORMAT_ARGB32,
+        proxy.getWidth(),
+        proxy.getHeight(),
+        proxy.getWidth() * 4
+    );
+
+    //the proxy shows the active layer only, layers above it are covered while previewing
+    cairo_save(cr);
+    cairo_scale(cr, factor, factor);
+    cairo_set_source_surface(cr, surface, 0, 0);
+    cairo_paint(cr);
+    cairo_restore(cr);
+    cairo_surface_destroy(surface);
+}
+
+void 
+AdjustTool::apply(Canvas& canvas){
+    if (cancelled || applied) return;
+    applied = true;
+    Adjustment(params).apply(canvas, selection);
+}
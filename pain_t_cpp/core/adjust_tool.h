@@ -0,0 +1,36 @@
+#ifndef ADJUST_TOOL_H
+#define ADJUST_TOOL_H
+
+#include "tool.h"
+#include "adjust.h"
+
+//Live colour adjustment. While parameters change only a downscaled proxy
+//of the layer is re-rendered and drawn as the overlay; the full resolution
+//pass runs once, in apply().
+class AdjustTool : public Tool{
+public:
+    explicit AdjustTool(const Canvas& source);
+
+    void press(Canvas&, int, int) override {}
+    bool editsPixels() const override {return false;}
+
+    void setParams(const AdjustParams& p);
+    void cancel(){cancelled = true;}
+
+    void drawOverlay(cairo_t* cr) override;
+    void apply(Canvas& canvas) override;
+
+private:
+    static constexpr int PROXY_MAX = 512;
+
+    void renderProxy();
+
+    int factor;             //proxy pixel = factor x factor source pixels
+    Canvas proxySource;
+    Canvas proxy;
+    AdjustParams params;
+    bool cancelled = false;
+    bool applied = false;
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "blend.h"
+
+#ifdef __SSE2__
+//x*y/255 on 8 unsigned 16-bit lanes holding values 0..255
+static inline __m128i 
+mulDiv255x8(__m128i x, __m128i y){
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+//broadcast the alpha lane of two unpacked pixels over their channels
+static inline __m128i 
+alphaOf(__m128i px){
+    px = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_shufflehi_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+//source-over of two unpacked pixels
+static inline __m128i 
+over2(__m128i d, __m128i s, __m128i op, __m128i full){
+    s = mulDiv255x8(s, op);
+    __m128i inv = _mm_sub_epi16(full, alphaOf(s));
+    return _mm_add_epi16(s, mulDiv255x8(d, inv));
+}
+#endif
+
+//----------per mode pixel operations----------
+//d and s premultiplied, cov 0..255 scales the source (Replace lerps instead)
+
+static inline uint32_t 
+mapChannels(uint32_t d, uint32_t s, uint32_t (*f)(uint32_t, uint32_t, uint32_t, uint32_t)){
+    uint32_t da = d >> 24, sa = s >> 24;
+    uint32_t out = 0;
+    for (int sh = 0; sh < 32; sh += 8)
+        out |= std::min<uint32_t>(255, f((d >> sh) & 0xFF, (s >> sh) & 0xFF, da, sa)) << sh;
+    return out;
+}
+
+static inline uint32_t 
+scale(uint32_t c, uint32_t cov){
+    if (cov == 255) return c;
+    return (mulDiv255(c >> 24, cov) << 24) | (mulDiv255((c >> 16) & 0xFF, cov) << 16) |
+           (mulDiv255((c >> 8) & 0xFF, cov) << 8) | mulDiv255(c & 0xFF, cov);
+}
+
+template<BlendMode M> struct BlendOp;
+
+template<> struct BlendOp<BlendMode::Normal>{
+    static uint32_t apply(uint32_t d, uint32_t s, uint32_t cov){return blendOver(d, s, cov);}
+#ifdef __SSE2__
+    static __m128i apply2(__m128i d, __m128i s, __m128i cov, __m128i full){
+        return over2(d, s, cov, full);
+    }
+#endif
+};
+
+template<> struct BlendOp<BlendMode::Replace>{
+    static uint32_t apply(uint32_t d, uint32_t s, uint32_t cov){
+        if (cov == 255) return s;
+        return scale(s, cov) + scale(d, 255 - cov);
+    }
+#ifdef __SSE2__
+    static __m128i apply2(__m128i d, __m128i s, __m128i cov, __m128i full){
+        return _mm_add_epi16(mulDiv255x8(s, cov), mulDiv255x8(d, _mm_sub_epi16(full, cov)));
+    }
+#endif
+};
+
+template<> struct BlendOp<BlendMode::Multiply>{
+    static uint32_t apply(uint32_t d, uint32_t s, uint32_t cov){
+        return mapChannels(d, scale(s, cov), [](uint32_t dc, uint32_t sc, uint32_t da, uint32_t sa){
+            return mulDiv255(sc, 255 - da) + mulDiv255(dc, 255 - sa) + mulDiv255(sc, dc);
+        });
+    }
+#ifdef __SSE2__
+    static __m128i apply2(__m128i d, __m128i s, __m128i cov, __m128i full){
+        s = mulDiv255x8(s, cov);
+        __m128i t = _mm_add_epi16(mulDiv255x8(s, _mm_sub_epi16(full, alphaOf(d))),
+                                  mulDiv255x8(d, _mm_sub_epi16(full, alphaOf(s))));
+        return _mm_add_epi16(t, mulDiv255x8(s, d));
+    }
+#endif
+};
+
+template<> struct BlendOp<BlendMode::Screen>{
+    static uint32_t apply(uint32_t d, uint32_t s, uint32_t cov){
+        return mapChannels(d, scale(s, cov), [](uint32_t dc, uint32_t sc, uint32_t, uint32_t){
+            return sc + dc - mulDiv255(sc, dc);
+        });
+    }
+#ifdef __SSE2__
+    static __m128i apply2(__m128i d, __m128i s, __m128i cov, __m128i){
+        s = mulDiv255x8(s, cov);
+        return _mm_sub_epi16(_mm_add_epi16(s, d), mulDiv255x8(s, d));
+    }
+#endif
+};
+
+template<> struct BlendOp<BlendMode::Erase>{
+    static uint32_t apply(uint32_t d, uint32_t s, uint32_t cov){
+        return scale(d, 255 - mulDiv255(s >> 24, cov));
+    }
+#ifdef __SSE2__
+    static __m128i apply2(__m128i d, __m128i s, __m128i cov, __m128i full){
+        return mulDiv255x8(d, _mm_sub_epi16(full, alphaOf(mulDiv255x8(s, cov))));
+    }
+#endif
+};
+
+//----------span kernels----------
+
+template<BlendMode M, bool Masked>
+static void 
+solidSpan(uint32_t* dst, const uint8_t* mask, int n, uint32_t color){
+    int i = 0;
+    if (!Masked && M == BlendMode::Replace){
+        std::fill(dst, dst + n, color);
+        return;
+    }
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i src  = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(color)), zero);
+
+    for (; i + 4 <= n; i += 4){
+        __m128i covLo = full, covHi = full;
+        if (Masked){
+            uint32_t m4;
+            std::memcpy(&m4, mask + i, 4);
+            if (m4 == 0) continue;
+
+            //replicate each coverage byte over the four channels of its pixel
+            __m128i cov = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(m4)), zero);
+            cov = _mm_unpacklo_epi16(cov, cov);
+            covLo = _mm_unpacklo_epi32(cov, cov);
+            covHi = _mm_unpackhi_epi32(cov, cov);
+        }
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = BlendOp<M>::apply2(_mm_unpacklo_epi8(d, zero), src, covLo, full);
+        __m128i hi = BlendOp<M>::apply2(_mm_unpackhi_epi8(d, zero), src, covHi, full);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i){
+        uint32_t cov = Masked ? mask[i] : 255;
+        if (cov) dst[i] = BlendOp<M>::apply(dst[i], color, cov);
+    }
+}
+
+//converts n source pixels to premultiplied ARGB32
+template<PixelFormat F>
+static void 
+loadPremultiplied(const uint8_t* src, uint32_t* out, int n){
+    for (int i = 0; i < n; ++i){
+        if (F == PixelFormat::ARGB32){
+            std::memcpy(out + i, src + 4*i, 4);
+        } else if (F == PixelFormat::RGBA8){
+            const uint8_t* p = src + 4*i;
+            out[i] = premultiply((uint32_t(p[3]) << 24) | (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2]);
+        } else{
+            const uint8_t* p = src + 3*i;
+            out[i] = 0xFF000000u | (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2];
+        }
+    }
+}
+
+template<BlendMode M, PixelFormat F>
+static void 
+pixelSpan(uint32_t* dst, const uint8_t* src, int n){
+    constexpr int BPP = (F == PixelFormat::RGB8) ? 3 : 4;
+    constexpr int CHUNK = 64;
+    uint32_t buf[CHUNK];
+
+    for (int c = 0; c < n; c += CHUNK){
+        int len = std::min(CHUNK, n - c);
+        loadPremultiplied<F>(src + c * BPP, buf, len);
+        uint32_t* out = dst + c;
+
+        int i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i full = _mm_set1_epi16(255);
+        for (; i + 4 <= len; i += 4){
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buf + i));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(out + i));
+            __m128i lo = BlendOp<M>::apply2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), full, full);
+            __m128i hi = BlendOp<M>::apply2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), full, full);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < len; ++i)
+            out[i] = BlendOp<M>::apply(out[i], buf[i], 255);
+    }
+}
+
+template<BlendMode M>
+static PixelSpanFn 
+pixelKernelFor(PixelFormat f){
+    switch (f){
+        case PixelFormat::RGBA8: return pixelSpan<M, PixelFormat::RGBA8>;
+        case PixelFormat::RGB8:  return pixelSpan<M, PixelFormat::RGB8>;
+        default:                 return pixelSpan<M, PixelFormat::ARGB32>;
+    }
+}
+
+SolidSpanFn 
+solidSpanKernel(BlendMode mode, bool masked){
+    switch (mode){
+        case BlendMode::Replace:  return masked ? solidSpan<BlendMode::Replace, true>  : solidSpan<BlendMode::Replace, false>;
+        case BlendMode::Multiply: return masked ? solidSpan<BlendMode::Multiply, true> : solidSpan<BlendMode::Multiply, false>;
+        case BlendMode::Screen:   return masked ? solidSpan<BlendMode::Screen, true>   : solidSpan<BlendMode::Screen, false>;
+        case BlendMode::Erase:    return masked ? solidSpan<BlendMode::Erase, true>    : solidSpan<BlendMode::Erase, false>;
+        default:                  return masked ? solidSpan<BlendMode::Normal, true>   : solidSpan<BlendMode::Normal, false>;
+    }
+}
+
+PixelSpanFn 
+pixelSpanKernel(BlendMode mode, PixelFormat format){
+    switch (mode){
+        case BlendMode::Replace:  return pixelKernelFor<BlendMode::Replace>(format);
+        case BlendMode::Multiply: return pixelKernelFor<BlendMode::Multiply>(format);
+        case BlendMode::Screen:   return pixelKernelFor<BlendMode::Screen>(format);
+        case BlendMode::Erase:    return pixelKernelFor<BlendMode::Erase>(format);
+        default:                  return pixelKernelFor<BlendMode::Normal>(format);
+    }
+}
+
+const char* 
+blendModeName(BlendMode mode){
+    switch (mode){
+        case BlendMode::Replace:  return "Replace";
+        case BlendMode::Multiply: return "Multiply";
+        case BlendMode::Screen:   return "Screen";
+        case BlendMode::Erase:    return "Erase";
+        default:                  return "Normal";
+    }
+}
+
+void 
+blendOverSpan(uint32_t* dst, const uint32_t* src, int n, uint8_t opacity){
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i op   = _mm_set1_epi16(opacity);
+
+    for (; i + 4 <= n; i += 4){
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+
+        //fully transparent source leaves dst untouched
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xFFFF) continue;
+
+        __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        __m128i lo = over2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), op, full);
+        __m128i hi = over2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), op, full);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = blendOver(dst[i], src[i], opacity);
+}
+
+void 
+blendMaskSpan(uint32_t* dst, const uint8_t* mask, int n, uint32_t color){
+    solidSpan<BlendMode::Normal, true>(dst, mask, n, color);
+}
+
+void 
+lerpMaskSpan(uint32_t* dst, const uint32_t* a, const uint32_t* b, const uint8_t* mask, int n, uint8_t strength){
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i str  = _mm_set1_epi16(strength);
+
+    for (; i + 4 <= n; i += 4){
+        uint32_t m4;
+        std::memcpy(&m4, mask + i, 4);
+        if (m4 == 0){
+            if (dst != a) std::memcpy(dst + i, a + i, 16);
+            continue;
+        }
+        //weights spread over the four channel lanes of each pixel
+        __m128i w = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(m4)), zero);
+        w = mulDiv255x8(_mm_unpacklo_epi16(w, w), str);
+        __m128i wlo = _mm_unpacklo_epi32(w, w), whi = _mm_unpackhi_epi32(w, w);
+
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        //a*(255-w) + b*w stays below 2^16, no signed differences needed
+        __m128i lo = _mm_add_epi16(mulDiv255x8(_mm_unpacklo_epi8(va, zero), _mm_sub_epi16(full, wlo)),
+                                   mulDiv255x8(_mm_unpacklo_epi8(vb, zero), wlo));
+        __m128i hi = _mm_add_epi16(mulDiv255x8(_mm_unpackhi_epi8(va, zero), _mm_sub_epi16(full, whi)),
+                                   mulDiv255x8(_mm_unpackhi_epi8(vb, zero), whi));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+#endif
+    for (; i < n; ++i){
+        uint32_t w = mulDiv255(mask[i], strength);
+        uint32_t pa = a[i], pb = b[i], out = 0;
+        for (int shift = 0; shift < 32; shift += 8){
+            uint32_t ca = (pa >> shift) & 0xFF, cb = (pb >> shift) & 0xFF;
+            out |= (mulDiv255(ca, 255 - w) + mulDiv255(cb, w)) << shift;
+        }
+        dst[i] = out;
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <cstdint>
+
+//all canvas pixels are cairo ARGB32, i.e. premultiplied 0xAARRGGBB
+
+enum class BlendMode{
+    Normal,     //source over
+    Replace,    //overwrite, coverage still interpolates
+    Multiply,
+    Screen,
+    Erase       //destination out, source alpha punches transparency
+};
+
+//layouts a source span can come in
+enum class PixelFormat{
+    ARGB32,     //premultiplied canvas pixels
+    RGBA8,      //straight alpha bytes, GdkPixbuf with alpha
+    RGB8        //opaque bytes, GdkPixbuf without alpha
+};
+
+//Span kernels are template instances per mode (and source format), picked
+//once per span so the per-pixel loop never branches on the mode.
+
+//constant premultiplied colour through an optional coverage mask (nullptr = full)
+using SolidSpanFn = void (*)(uint32_t* dst, const uint8_t* mask, int n, uint32_t color);
+//n source pixels laid out as the kernel's PixelFormat
+using PixelSpanFn = void (*)(uint32_t* dst, const uint8_t* src, int n);
+
+SolidSpanFn solidSpanKernel(BlendMode mode, bool masked);
+PixelSpanFn pixelSpanKernel(BlendMode mode, PixelFormat format);
+
+const char* blendModeName(BlendMode mode);
+
+//(a*b)/255 with correct rounding
+inline uint32_t 
+mulDiv255(uint32_t a, uint32_t b){
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+//source-over of one premultiplied pixel, src scaled by opacity (0..255)
+inline uint32_t 
+blendOver(uint32_t dst, uint32_t src, uint32_t opacity){
+    if (opacity != 255){
+        src = (mulDiv255(src >> 24, opacity) << 24) |
+              (mulDiv255((src >> 16) & 0xFF, opacity) << 16) |
+              (mulDiv255((src >> 8) & 0xFF, opacity) << 8) |
+              mulDiv255(src & 0xFF, opacity);
+    }
+    uint32_t inv = 255 - (src >> 24);
+    if (inv == 0) return src;
+    if (inv == 255) return dst;
+
+    return (((src >> 24) + mulDiv255(dst >> 24, inv)) << 24) |
+           ((((src >> 16) & 0xFF) + mulDiv255((dst >> 16) & 0xFF, inv)) << 16) |
+           ((((src >> 8) & 0xFF) + mulDiv255((dst >> 8) & 0xFF, inv)) << 8) |
+           ((src & 0xFF) + mulDiv255(dst & 0xFF, inv));
+}
+
+//straight 0xAARRGGBB (as picked in the colour chooser) to premultiplied
+inline uint32_t 
+premultiply(uint32_t c){
+    uint32_t a = c >> 24;
+    if (a == 255) return c;
+    return (a << 24) |
+           (mulDiv255((c >> 16) & 0xFF, a) << 16) |
+           (mulDiv255((c >> 8) & 0xFF, a) << 8) |
+           mulDiv255(c & 0xFF, a);
+}
+
+//dst[i] = src[i]*opacity over dst[i] for n pixels (SSE2 when available)
+void blendOverSpan(uint32_t* dst, const uint32_t* src, int n, uint8_t opacity);
+
+//dst[i] = color*mask[i] over dst[i], color premultiplied
+void blendMaskSpan(uint32_t* dst, const uint8_t* mask, int n, uint32_t color);
+
+//dst[i] = a[i] + (b[i] - a[i]) * mask[i]*strength/255^2, per channel; dst may alias a or b
+void lerpMaskSpan(uint32_t* dst, const uint32_t* a, const uint32_t* b, const uint8_t* mask, int n, uint8_t strength);
+
+#endif
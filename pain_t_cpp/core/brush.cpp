@@ -3,9 +3,27 @@
 
 #include "brush.h"
 #include "canvas.h"
+#include "blend.h"
+#include "dab_cache.h"
+#include "parallel.h"
+#include "trace.h"
 
-Brush::Brush(uint32_t color, int size)
-    : color(color), size(size), lastX(0), lastY(0), hasLast(false)
+namespace{
+
+//half width of row dy of an aliased disc of radius r, -1 outside it
+int 
+discHalf(int r, int dy){
+    if (dy < -r || dy > r) return -1;
+    int half = static_cast<int>(std::sqrt(static_cast<float>(r*r - dy*dy)));
+    while ((half + 1) * (half + 1) + dy*dy <= r*r) ++half;
+    while (half * half + dy*dy > r*r) --half;
+    return half;
+}
+
+} //namespace
+
+Brush::Brush(uint32_t color, int size, BlendMode mode)
+    : color(color), size(size), mode(mode), lastX(0), lastY(0), hasLast(false)
 {
     setSize(size);
 }
@@ -15,9 +33,16 @@ Brush::setSize(int s){
     size = std::clamp(s, 1, 100);
 }
 
+void 
+Brush::setHardness(int h){
+    hardness = std::clamp(h, 0, 100);
+}
+
 void 
 Brush::press(Canvas& c, int x, int y){
-    drawCircle(c, x, y, size);
+    dab(c, static_cast<float>(x), static_cast<float>(y));
+    paintSymmetric(c);
+    carry = 0.0f;
     lastX = x;
     lastY = y;
     hasLast = true;
@@ -29,7 +54,11 @@ Brush::drag(Canvas& c, int x, int y){
         press(c, x, y);
         return;
     }
-    drawLine(c, lastX, lastY, x, y);
+    if (antialias)
+        drawLineSmooth(c, lastX, lastY, x, y);
+    else
+        drawLine(c, lastX, lastY, x, y);
+    paintSymmetric(c);
     lastX = x;
     lastY = y;
 }
@@ -42,12 +71,26 @@ Brush::release(Canvas& c, int x, int y){
 
 void 
 Brush::drawCircle(Canvas& c, int cx, int cy, int r){
+    //one kernel lookup per dab, then whole clipped rows of the disc
+    SolidSpanFn span = solidSpanKernel(mode, false);
+    uint32_t src = premultiply(color);
+    uint32_t* pixels = c.getPixels().data();
+    int w = c.getWidth();
+    int h = c.getHeight();
+
     for (int y = -r; y <= r; y++) {
-        for (int x = -r; x <= r; x++) {
-            if (x*x + y*y <= r*r)
-                c.setPixel(cx + x, cy + y, color);
-        }
+        int py = cy + y;
+        if (py < 0 || py >= h) continue;
+
+        int half = discHalf(r, y);
+        int x0 = std::max(cx - half, 0);
+        int x1 = std::min(cx + half + 1, w);
+        uint32_t* row = pixels + static_cast<size_t>(py) * w;
+        forSelected(py, x0, x1, [&](int a, int b){
+            span(row + a, nullptr, b - a, src);
+        });
     }
+    c.markDirty(cx - r, cy - r, 2*r + 1, 2*r + 1);
 }
 
 void 
@@ -59,7 +102,7 @@ Brush::drawLine(Canvas& c, int x0, int y0, int x1, int y1){
     int err = dx - dy;
 
     while (true) {
-        drawCircle(c, x0, y0, size);
+        dab(c, static_cast<float>(x0), static_cast<float>(y0));
         if (x0==x1 && y0==y1) break;
 
         int e2 = 2 * err;
@@ -67,3 +110,191 @@ Brush::drawLine(Canvas& c, int x0, int y0, int x1, int y1){
         if (e2<dx) {err+=dx; y0+=sy;}
     }
 }
+
+void 
+Brush::stampDab(Canvas& c, float cx, float cy){
+    //integer input positions address pixel centres
+    cx += 0.5f;
+    cy += 0.5f;
+    float fx = std::floor(cx);
+    float fy = std::floor(cy);
+    int sx = static_cast<int>((cx - fx) * DabCache::SUBPIXEL);
+    int sy = static_cast<int>((cy - fy) * DabCache::SUBPIXEL);
+    const DabMask& m = DabCache::shared().get(size, hardness, sx, sy);
+
+    int ox = static_cast<int>(fx) - m.origin;
+    int oy = static_cast<int>(fy) - m.origin;
+    int x0 = std::max(0, ox), x1 = std::min(c.getWidth(),  ox + m.size);
+    int y0 = std::max(0, oy), y1 = std::min(c.getHeight(), oy + m.size);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    SolidSpanFn span = solidSpanKernel(mode, true);
+    uint32_t src = premultiply(color);
+    uint32_t* pixels = c.getPixels().data();
+    for (int y = y0; y < y1; ++y){
+        uint32_t* row = pixels + static_cast<size_t>(y) * c.getWidth();
+        const uint8_t* cov = m.coverage.data() + (y - oy) * m.size;
+        forSelected(y, x0, x1, [&](int a, int b){
+            span(row + a, cov + (a - ox), b - a, src);
+        });
+    }
+    c.markDirty(x0, y0, x1 - x0, y1 - y0);
+}
+
+void 
+Brush::drawLineSmooth(Canvas& c, float x0, float y0, float x1, float y1){
+    //evenly spaced dabs, the leftover distance carries into the next segment
+    float spacing = std::max(0.5f, size * 0.25f);
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float len = std::sqrt(dx*dx + dy*dy);
+    if (len <= 0.0f) return;
+
+    float t = spacing - carry;
+    while (t <= len){
+        dab(c, x0 + dx * t / len, y0 + dy * t / len);
+        t += spacing;
+    }
+    carry = len - (t - spacing);
+}
+
+void 
+Brush::dab(Canvas& c, float x, float y){
+    if (symmetric()){
+        queued.emplace_back(x, y);
+        return;
+    }
+    if (antialias) stampDab(c, x, y);
+    else drawCircle(c, static_cast<int>(x), static_cast<int>(y), size);
+}
+
+void 
+Brush::paintSymmetric(Canvas& c){
+    if (queued.empty()) return;
+    TRACE_SCOPE("Brush::paintSymmetric");
+
+    //where each copy lands; masks are looked up here, the cache is not
+    //thread safe. Aliased copies have no mask and are discs around (cx, cy).
+    struct Copy{
+        int ox, oy, side;
+        const DabMask* mask;
+        int cx, cy;
+    };
+    int w = c.getWidth(), h = c.getHeight();
+    int n = symmetry->count();
+    std::vector<Copy> copies;
+    copies.reserve(queued.size() * n);
+    float xs[Symmetry::MAX_COPIES], ys[Symmetry::MAX_COPIES];
+    int bx0 = w, by0 = h, bx1 = 0, by1 = 0;
+
+    for (const auto& [qx, qy] : queued){
+        symmetry->apply(qx, qy, w, h, xs, ys);
+        for (int k = 0; k < n; ++k){
+            Copy cp{};
+            if (antialias){
+                //nearest quarter pixel rather than floor, so mirrored copies
+                //pick mirrored masks
+                int qx = static_cast<int>(std::lround((xs[k] + 0.5f) * DabCache::SUBPIXEL));
+                int qy = static_cast<int>(std::lround((ys[k] + 0.5f) * DabCache::SUBPIXEL));
+                int fx = qx >= 0 ? qx / DabCache::SUBPIXEL : -((-qx + DabCache::SUBPIXEL - 1) / DabCache::SUBPIXEL);
+                int fy = qy >= 0 ? qy / DabCache::SUBPIXEL : -((-qy + DabCache::SUBPIXEL - 1) / DabCache::SUBPIXEL);
+                cp.mask = &DabCache::shared().get(size, hardness, qx - fx * DabCache::SUBPIXEL, qy - fy * DabCache::SUBPIXEL);
+                cp.side = cp.mask->size;
+                cp.ox = fx - cp.mask->origin;
+                cp.oy = fy - cp.mask->origin;
+            } else{
+                cp.cx = static_cast<int>(std::lround(xs[k]));
+                cp.cy = static_cast<int>(std::lround(ys[k]));
+                cp.side = 2 * size + 1;
+                cp.ox = cp.cx - size;
+                cp.oy = cp.cy - size;
+            }
+            copies.push_back(cp);
+            bx0 = std::min(bx0, std::max(cp.ox, 0));
+            by0 = std::min(by0, std::max(cp.oy, 0));
+            bx1 = std::max(bx1, std::min(cp.ox + cp.side, w));
+            by1 = std::max(by1, std::min(cp.oy + cp.side, h));
+        }
+    }
+    size_t dabs = queued.size();
+    queued.clear();
+    if (bx0 >= bx1 || by0 >= by1) return;
+
+    SolidSpanFn solid = solidSpanKernel(mode, false);
+    SolidSpanFn masked = solidSpanKernel(mode, true);
+    uint32_t src = premultiply(color);
+    uint32_t* pixels = c.getPixels().data();
+
+    //rows are independent, and within a row the dabs keep their order
+    parallelFor(by0, by1, 8, [&](int y0, int y1){
+        struct Piece{
+            int a, b;
+            const uint8_t* cov;     //coverage at x = a, null for a solid run
+        };
+        std::vector<Piece> pieces;
+        std::vector<uint8_t> merged;
+
+        auto emit = [&](int y, int a, int b, const uint8_t* cov){
+            uint32_t* row = pixels + static_cast<size_t>(y) * w;
+            forSelected(y, a, b, [&](int p, int q){
+                if (cov) masked(row + p, cov + (p - a), q - p, src);
+                else solid(row + p, nullptr, q - p, src);
+            });
+        };
+
+        for (int y = y0; y < y1; ++y){
+            for (size_t d = 0; d < dabs; ++d){
+                pieces.clear();
+                for (int k = 0; k < n; ++k){
+                    const Copy& cp = copies[d * n + k];
+                    if (y < cp.oy || y >= cp.oy + cp.side) continue;
+                    Piece p;
+                    if (cp.mask){
+                        p.a = cp.ox;
+                        p.b = cp.ox + cp.side;
+                        p.cov = cp.mask->coverage.data() + static_cast<size_t>(y - cp.oy) * cp.side;
+                    } else{
+                        int half = discHalf(size, y - cp.cy);
+                        if (half < 0) continue;
+                        p.a = cp.cx - half;
+                        p.b = cp.cx + half + 1;
+                        p.cov = nullptr;
+                    }
+                    int a = std::max(p.a, 0), b = std::min(p.b, w);
+                    if (a >= b) continue;
+                    if (p.cov) p.cov += a - p.a;
+                    p.a = a;
+                    p.b = b;
+                    pieces.push_back(p);
+                }
+                std::sort(pieces.begin(), pieces.end(), [](const Piece& l, const Piece& r){return l.a < r.a;});
+
+                for (size_t i = 0; i < pieces.size();){
+                    int ga = pieces[i].a, gb = pieces[i].b;
+                    size_t j = i + 1;
+                    while (j < pieces.size() && pieces[j].a < gb) gb = std::max(gb, pieces[j++].b);
+                    if (j == i + 1){
+                        emit(y, ga, gb, pieces[i].cov);
+                        i = j;
+                        continue;
+                    }
+
+                    //overlapping copies: strongest coverage wins
+                    merged.assign(gb - ga, 0);
+                    for (size_t k = i; k < j; ++k){
+                        const Piece& p = pieces[k];
+                        uint8_t* m = merged.data() + (p.a - ga);
+                        if (!p.cov){
+                            std::fill(m, m + (p.b - p.a), 255);
+                            continue;
+                        }
+                        for (int x = 0; x < p.b - p.a; ++x) m[x] = std::max(m[x], p.cov[x]);
+                    }
+                    emit(y, ga, gb, merged.data());
+                    i = j;
+                }
+            }
+        }
+    });
+    c.markDirty(bx0, by0, bx1 - bx0, by1 - by0);
+}
@@ -2,16 +2,19 @@
 #define BRUSH_H
 
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "tool.h"
 
 class Brush : public Tool{
 public:
-    Brush(uint32_t color, int size = 1);
+    Brush(uint32_t color, int size = 1, BlendMode mode = BlendMode::Normal);
 
     void press(Canvas& canvas, int x, int y) override;
     void drag(Canvas& canvas, int x, int y) override;
     void release(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> clone() const override{return std::make_unique<Brush>(*this);}
 
     bool usesColor() const override{return true;}
     void setColor(uint32_t c) override{color = c;}
@@ -21,12 +24,40 @@ public:
     void setSize(int s) override;
     int getSize() const override{return size;}
 
+    bool supportsBlendMode() const override{return true;}
+    void setBlendMode(BlendMode m) override{mode = m;}
+    BlendMode getBlendMode() const override{return mode;}
+
+    bool supportsSymmetry() const override{return true;}
+
+    bool supportsSoftness() const override{return true;}
+    void setAntialias(bool on) override{antialias = on;}
+    bool getAntialias() const override{return antialias;}
+    void setHardness(int h) override;
+    int getHardness() const override{return hardness;}
+
 private:
+    //one dab: painted right away, or queued for the symmetric pass
+    void dab(Canvas& c, float x, float y);
+    bool symmetric() const{return symmetry && symmetry->count() > 1;}
+    //every copy of the queued dabs, in row bands on the pool; copies of the
+    //same dab that overlap are merged first so no pixel is blended twice
+    void paintSymmetric(Canvas& c);
+
     void drawCircle(Canvas& c, int cx, int cy, int r);
     void drawLine(Canvas& c, int x0, int y0, int x1, int y1);
+
+    //anti-aliased path: stamps cached coverage masks at sub-pixel positions
+    void stampDab(Canvas& c, float cx, float cy);
+    void drawLineSmooth(Canvas& c, float x0, float y0, float x1, float y1);
     
     uint32_t color;
     int size;
+    BlendMode mode;
+    bool antialias = false;
+    int hardness = 100;
+    float carry = 0.0f;     //distance walked since the last dab
+    std::vector<std::pair<float, float>> queued;
 
     int lastX;
     int lastY;
@@ -1,37 +1,126 @@
 #include <cairo.h>
 #include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 
 #include "canvas.h"
+#include "trace.h"
 
-Canvas::Canvas(int w, int h) : width(w), height(h), pixels(w * h, 0xFFFFFFFF){}
+namespace{
+
+int64_t 
+bytesOf(const std::vector<uint32_t>& v){
+    return static_cast<int64_t>(v.capacity() * sizeof(uint32_t));
+}
+
+//the buffer stays reported until its last owner, canvas or snapshot, lets go
+std::shared_ptr<std::vector<uint32_t>> 
+trackedPixels(MemCategory cat, std::vector<uint32_t> v){
+    MemoryStats::add(cat, bytesOf(v));
+    return std::shared_ptr<std::vector<uint32_t>>(
+        new std::vector<uint32_t>(std::move(v)),
+        [cat](std::vector<uint32_t>* p){
+            MemoryStats::add(cat, -bytesOf(*p));
+            delete p;
+        });
+}
+
+} //namespace
+
+Canvas::Canvas(int w, int h, MemCategory cat) 
+    : width(w), height(h), category(cat), pixels(trackedPixels(cat, std::vector<uint32_t>(w * h, 0xFFFFFFFF)))
+    {
+    markAllDirty();
+}
+
+std::vector<uint32_t>& 
+Canvas::detach(){
+    if (pixels.use_count() > 1)
+        pixels = trackedPixels(category, *pixels);
+    else
+        //pairs with the release of a snapshot dropped on a pool thread
+        std::atomic_thread_fence(std::memory_order_acquire);
+    return *pixels;
+}
+
+void 
+Canvas::setSize(int w, int h){
+    width = w;
+    height = h;
+    std::vector<uint32_t>& px = detach();
+    int64_t before = bytesOf(px);
+    px.resize(w * h, 0xFFFFFFFF);
+    MemoryStats::add(category, bytesOf(px) - before);
+    markAllDirty();
+}
+
+void 
+Canvas::scroll(int dx, int dy){
+    if ((dx == 0 && dy == 0) || std::abs(dx) >= width || std::abs(dy) >= height) return;
+    uint32_t* px = detach().data();
+    size_t n = static_cast<size_t>(width - std::abs(dx)) * sizeof(uint32_t);
+    int sx = std::max(0, -dx), tx = std::max(0, dx);
+    auto move = [&](int y){
+        std::memmove(px + static_cast<size_t>(y) * width + tx, px + static_cast<size_t>(y - dy) * width + sx, n);
+    };
+    //rows are walked against the motion, none is overwritten before it moved
+    if (dy > 0)
+        for (int y = height - 1; y >= dy; --y) move(y);
+    else
+        for (int y = 0; y < height + dy; ++y) move(y);
+}
 
 uint32_t 
 Canvas::getPixel(int x, int y) const{
     if (x < 0 || y < 0 || x >= width || y >= height)
         return 0;
-    return pixels[y * width + x];
+    return (*pixels)[y * width + x];
 }
 
 void 
 Canvas::setPixel(int x, int y, uint32_t color){
     if (x < 0 || y < 0 || x >= width || y >= height)
         return;
-    pixels[y * width + x] = color;
+    detach()[y * width + x] = color;
+
+    dirtyX0 = std::min(dirtyX0, x);
+    dirtyY0 = std::min(dirtyY0, y);
+    dirtyX1 = std::max(dirtyX1, x + 1);
+    dirtyY1 = std::max(dirtyY1, y + 1);
 }
 
 void 
 Canvas::clear(uint32_t color){
-    std::fill(pixels.begin(), pixels.end(), color);
+    std::vector<uint32_t>& px = detach();
+    std::fill(px.begin(), px.end(), color);
+    markAllDirty();
+}
+
+Rect 
+Canvas::takeDirty(){
+    Rect r;
+    if (isDirty())
+        r = {dirtyX0, dirtyY0, dirtyX1 - dirtyX0, dirtyY1 - dirtyY0};
+    dirtyX0 = dirtyY0 = INT_MAX;
+    dirtyX1 = dirtyY1 = INT_MIN;
+    return r;
 }
 
 bool 
 Canvas::savePNG(const std::string& path) const{
+    return writePNG(*pixels, width, height, path);
+}
+
+bool 
+Canvas::writePNG(const std::vector<uint32_t>& pixels, int w, int h, const std::string& path){
+    TRACE_SCOPE("Canvas::writePNG");
     cairo_surface_t* surface = cairo_image_surface_create_for_data(
         reinterpret_cast<unsigned char*>(const_cast<uint32_t*>(pixels.data())), 
         CAIRO_FORMAT_ARGB32,
-        width,
-        height,
-        width * 4
+        w,
+        h,
+        w * 4
     );
 
     cairo_status_t status = cairo_surface_write_to_png(surface, path.c_str());
@@ -39,4 +128,3 @@ Canvas::savePNG(const std::string& path) const{
 
     return status == CAIRO_STATUS_SUCCESS;
 }
-
@@ -4,10 +4,44 @@
 #include <cstdint>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <climits>
+#include <memory>
+
+#include "memory.h"
+
+struct Rect{
+    int x = 0, y = 0;
+    int w = 0, h = 0;
+
+    bool empty() const {return w <= 0 || h <= 0;}
+
+    //overlap of the two, empty when they don't meet
+    Rect intersect(const Rect& o) const{
+        int x0 = std::max(x, o.x), y0 = std::max(y, o.y);
+        int x1 = std::min(x + w, o.x + o.w), y1 = std::min(y + h, o.y + o.h);
+        return {x0, y0, std::max(0, x1 - x0), std::max(0, y1 - y0)};
+    }
+    //smallest rectangle covering both
+    Rect unite(const Rect& o) const{
+        if (empty()) return o;
+        if (o.empty()) return *this;
+        int x0 = std::min(x, o.x), y0 = std::min(y, o.y);
+        int x1 = std::max(x + w, o.x + o.w), y1 = std::max(y + h, o.y + o.h);
+        return {x0, y0, x1 - x0, y1 - y0};
+    }
+};
+
+//horizontal run of pixels [x0, x1) on row y
+struct Span{
+    int y;
+    int x0, x1;
+};
 
 class Canvas{
 public:
-    Canvas(int width, int height);
+    //cat decides where the pixels show up in MemoryStats
+    Canvas(int width, int height, MemCategory cat = MemCategory::Layers);
     ~Canvas() = default;
 
     int getWidth() const {return width;}
@@ -17,15 +51,14 @@ public:
     void setPixel(int x, int y, uint32_t color);
     void clear(uint32_t color);
 
-    void 
-    setSize(int w, int h) {
-        width = w;
-        height = h;
-        pixels.resize(w * h, 0xFFFFFFFF);
-    }
+    void setSize(int w, int h);
+    //moves the content by (dx, dy), the area it uncovers keeps stale pixels;
+    //damage is left to the caller
+    void scroll(int dx, int dy);
 
     void 
     setPixelsBlock(int x, int y, int w, int h, const std::vector<uint32_t>& data){
+        std::vector<uint32_t>& pixels = detach();
         for (int iy = 0; iy < h; ++iy){
             int cy = y + iy;
             if (cy < 0 || cy >= height) continue;
@@ -35,18 +68,46 @@ public:
                 pixels[cy * width + cx] = data[iy * w + ix];
             }
         }
+        markDirty(x, y, w, h);
     }
     
     bool savePNG(const std::string& path) const;
+    //same for a snapshot(), usable from a pool thread
+    static bool writePNG(const std::vector<uint32_t>& pixels, int w, int h, const std::string& path);
+
+    const std::vector<uint32_t>& getPixels() const{return *pixels;}
+
+    //writing through this does not track damage, call markDirty() afterwards
+    std::vector<uint32_t>& getPixels(){return detach();}
 
-    const std::vector<uint32_t>& getPixels() const{return pixels;}
+    //read-only reference to the current pixels, later edits copy instead of touching it
+    std::shared_ptr<const std::vector<uint32_t>> snapshot() const{return pixels;}
 
-    std::vector<uint32_t>& getPixels(){return pixels;}
+    //damage tracking, used by LayerStack to recomposite only what changed
+    void 
+    markDirty(int x, int y, int w, int h){
+        if (w <= 0 || h <= 0) return;
+        dirtyX0 = std::min(dirtyX0, std::max(x, 0));
+        dirtyY0 = std::min(dirtyY0, std::max(y, 0));
+        dirtyX1 = std::max(dirtyX1, std::min(x + w, width));
+        dirtyY1 = std::max(dirtyY1, std::min(y + h, height));
+    }
+    void markAllDirty(){markDirty(0, 0, width, height);}
+    bool isDirty() const {return dirtyX1 > dirtyX0 && dirtyY1 > dirtyY0;}
+    Rect peekDirty() const {return isDirty() ? Rect{dirtyX0, dirtyY0, dirtyX1 - dirtyX0, dirtyY1 - dirtyY0} : Rect();}
+    Rect takeDirty();
 
 private:
+    //copy-on-write, only shared while a snapshot() is alive
+    std::vector<uint32_t>& detach();
+
     int width;
     int height;
-    std::vector<uint32_t> pixels;
+    MemCategory category;
+    std::shared_ptr<std::vector<uint32_t>> pixels;
+
+    int dirtyX0 = INT_MAX, dirtyY0 = INT_MAX;
+    int dirtyX1 = INT_MIN, dirtyY1 = INT_MIN;
 };
 
 
@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <cstring>
+
+#include "clipboard.h"
+
+ClipboardImage::ClipboardImage(const Canvas& canvas, const Selection& sel)
+    : pixels(canvas.snapshot()), stride(canvas.getWidth()), mask(sel)
+    {
+    region = {0, 0, canvas.getWidth(), canvas.getHeight()};
+    //a moved selection may reach past the canvas, what lies outside isn't copied
+    if (sel.isActive()) region = sel.bounds().intersect(region);
+}
+
+ClipboardImage::~ClipboardImage(){
+    if (encoded)
+        g_object_unref(encoded);
+}
+
+GdkPixbuf* 
+ClipboardImage::pixbuf(){
+    if (encoded || empty()) return encoded;
+
+    encoded = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8, region.w, region.h);
+    if (!encoded) return nullptr;
+    int rowStride = gdk_pixbuf_get_rowstride(encoded);
+    guchar* out = gdk_pixbuf_get_pixels(encoded);
+
+    for (int y = 0; y < region.h; ++y){
+        guchar* row = out + y * rowStride;
+        const uint32_t* src = pixels->data() + static_cast<size_t>(region.y + y) * stride + region.x;
+        //unselected pixels stay transparent
+        std::memset(row, 0, region.w * 4);
+        mask.clipSpan(region.y + y, region.x, region.x + region.w, [&](int a, int b){
+            for (int x = a - region.x; x < b - region.x; ++x){
+                uint32_t c = src[x];
+                uint32_t al = c >> 24;
+                guchar* p = row + x * 4;
+                if (al){
+                    //unpremultiply, rounding to nearest
+                    p[0] = static_cast<guchar>((((c >> 16) & 0xFF) * 255 + al / 2) / al);
+                    p[1] = static_cast<guchar>((((c >> 8) & 0xFF) * 255 + al / 2) / al);
+                    p[2] = static_cast<guchar>(((c & 0xFF) * 255 + al / 2) / al);
+                }
+                p[3] = static_cast<guchar>(al);
+            }
+        });
+    }
+
+    encodedBytes.resize(static_cast<int64_t>(rowStride) * region.h);
+
+    //the pixbuf is all the clipboard needs from now on
+    pixels.reset();
+    return encoded;
+}
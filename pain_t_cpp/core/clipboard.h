@@ -0,0 +1,39 @@
+#ifndef CLIPBOARD_H
+#define CLIPBOARD_H
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+#include <memory>
+#include <vector>
+
+#include "canvas.h"
+#include "selection.h"
+#include "memory.h"
+
+//Image offered to the clipboard. Holds a snapshot of the canvas pixels
+//plus the selection, and only builds a pixbuf when another application
+//actually asks for the data, so copying costs nothing up front.
+class ClipboardImage{
+public:
+    //the selected part of canvas, or all of it when sel is inactive
+    ClipboardImage(const Canvas& canvas, const Selection& sel);
+    ~ClipboardImage();
+
+    ClipboardImage(const ClipboardImage&) = delete;
+    ClipboardImage& operator=(const ClipboardImage&) = delete;
+
+    bool empty() const {return region.empty();}
+
+    //straight-alpha RGBA, built on first use and owned by this object
+    GdkPixbuf* pixbuf();
+
+private:
+    std::shared_ptr<const std::vector<uint32_t>> pixels;
+    int stride = 0;
+    Rect region;
+    Selection mask;
+
+    GdkPixbuf* encoded = nullptr;
+    MemoryCharge encodedBytes{MemCategory::Clipboard, 0};
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "color_match.h"
+
+//perceptual weights for the A, R, G, B channels, they sum up to 12
+static constexpr int W_A = 3, W_R = 3, W_G = 4, W_B = 2;
+
+bool 
+ColorMatch::matches(uint32_t px) const{
+    int da = std::abs(int(px >> 24) - int(target >> 24));
+    int dr = std::abs(int((px >> 16) & 0xFF) - int((target >> 16) & 0xFF));
+    int dg = std::abs(int((px >> 8) & 0xFF) - int((target >> 8) & 0xFF));
+    int db = std::abs(int(px & 0xFF) - int(target & 0xFF));
+
+    if (mode == MatchMode::PerChannel)
+        return da <= tolerance && dr <= tolerance && dg <= tolerance && db <= tolerance;
+
+    int d = W_A*da*da + W_R*dr*dr + W_G*dg*dg + W_B*db*db;
+    return d <= 12 * tolerance * tolerance;
+}
+
+#ifdef __SSE2__
+//per-byte |a - b|
+static inline __m128i 
+absDiff8(__m128i a, __m128i b){
+    return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+}
+
+//0xFFFFFFFF lanes for the 4 pixels of px that match
+static inline __m128i 
+match4PerChannel(__m128i px, __m128i tgt, __m128i tol){
+    __m128i over = _mm_subs_epu8(absDiff8(px, tgt), tol);
+    return _mm_cmpeq_epi32(over, _mm_setzero_si128());
+}
+
+static inline __m128i 
+match4Perceptual(__m128i px, __m128i tgt, __m128i weights, __m128i limit){
+    const __m128i zero = _mm_setzero_si128();
+    __m128i diff = absDiff8(px, tgt);
+    __m128i lo = _mm_unpacklo_epi8(diff, zero);
+    __m128i hi = _mm_unpackhi_epi8(diff, zero);
+
+    //madd yields [w_b*b^2 + w_g*g^2, w_r*r^2 + w_a*a^2] per pixel
+    __m128i slo = _mm_madd_epi16(lo, _mm_mullo_epi16(lo, weights));
+    __m128i shi = _mm_madd_epi16(hi, _mm_mullo_epi16(hi, weights));
+
+    //fold the pairs: one 32-bit distance per pixel, in pixel order
+    __m128i a = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(slo), _mm_castsi128_ps(shi), _MM_SHUFFLE(2, 0, 2, 0)));
+    __m128i b = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(slo), _mm_castsi128_ps(shi), _MM_SHUFFLE(3, 1, 3, 1)));
+    __m128i d = _mm_add_epi32(a, b);
+
+    return _mm_cmpgt_epi32(limit, d);
+}
+#endif
+
+void 
+ColorMatch::matchSpan(const uint32_t* src, int n, uint8_t* mask) const{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i tgt = _mm_set1_epi32(static_cast<int>(target));
+    const __m128i tol = _mm_set1_epi8(static_cast<char>(tolerance));
+    const __m128i weights = _mm_setr_epi16(W_B, W_G, W_R, W_A, W_B, W_G, W_R, W_A);
+    const __m128i limit = _mm_set1_epi32(12 * tolerance * tolerance + 1);
+    const __m128i one = _mm_set1_epi8(1);
+    bool perChannel = (mode == MatchMode::PerChannel);
+
+    //16 pixels per step, four compare results narrowed into 16 mask bytes
+    for (; i + 16 <= n; i += 16){
+        __m128i m[4];
+        for (int k = 0; k < 4; ++k){
+            __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4*k));
+            m[k] = perChannel ? match4PerChannel(px, tgt, tol)
+                              : match4Perceptual(px, tgt, weights, limit);
+        }
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(m[0], m[1]), _mm_packs_epi32(m[2], m[3]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + i), _mm_and_si128(packed, one));
+    }
+#endif
+    for (; i < n; ++i)
+        mask[i] = matches(src[i]) ? 1 : 0;
+}
+
+int 
+findSet(const uint8_t* mask, int from, int to){
+    int i = from;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= to; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+        int bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF;
+        if (bits) return i + __builtin_ctz(bits);
+    }
+#endif
+    for (; i < to; ++i)
+        if (mask[i]) return i;
+    return to;
+}
+
+int 
+findClear(const uint8_t* mask, int from, int to){
+    int i = from;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= to; i += 16){
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i));
+        int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero));
+        if (bits) return i + __builtin_ctz(bits);
+    }
+#endif
+    for (; i < to; ++i)
+        if (!mask[i]) return i;
+    return to;
+}
@@ -0,0 +1,27 @@
+#ifndef COLOR_MATCH_H
+#define COLOR_MATCH_H
+
+#include <cstdint>
+
+enum class MatchMode{
+    PerChannel,     //every channel within tolerance of the target
+    Perceptual      //weighted euclidean distance within tolerance
+};
+
+//Decides which pixels belong to a fill region. Spans are tested in bulk
+//and produce byte masks (1 = match), so callers can consume whole runs.
+struct ColorMatch{
+    uint32_t target = 0;
+    int tolerance = 0;      //0..255, 0 means exact
+    MatchMode mode = MatchMode::PerChannel;
+
+    bool matches(uint32_t px) const;
+    void matchSpan(const uint32_t* src, int n, uint8_t* mask) const;
+};
+
+//index of the first non-zero byte in mask[from, to), or to if there is none
+int findSet(const uint8_t* mask, int from, int to);
+//index of the first zero byte in mask[from, to), or to if there is none
+int findClear(const uint8_t* mask, int from, int to);
+
+#endif
@@ -0,0 +1,66 @@
+#include <algorithm>
+#include <cmath>
+
+#include "dab_cache.h"
+
+DabCache& 
+DabCache::shared(){
+    static DabCache cache;
+    return cache;
+}
+
+const DabMask& 
+DabCache::get(int radius, int hardness, int sx, int sy){
+    hardness = std::clamp(hardness, 0, 100) / HARDNESS_STEP * HARDNESS_STEP;
+    uint64_t key = (static_cast<uint64_t>(radius) << 24) |
+                   (static_cast<uint64_t>(hardness) << 8) |
+                   (static_cast<uint64_t>(sx) << 4) |
+                   static_cast<uint64_t>(sy);
+
+    auto it = masks.find(key);
+    if (it != masks.end()) return *it->second;
+
+    //crude but bounded: drop everything once the budget is exceeded
+    if (bytes > BUDGET) clear();
+
+    auto mask = std::make_unique<DabMask>(build(radius, hardness, sx, sy));
+    bytes += mask->coverage.size();
+    charge.resize(static_cast<int64_t>(bytes + retiredBytes));
+    return *masks.emplace(key, std::move(mask)).first->second;
+}
+
+void 
+DabCache::clear(){
+    retired = std::move(masks);
+    retiredBytes = bytes;
+    masks = MaskMap();
+    bytes = 0;
+    charge.resize(static_cast<int64_t>(retiredBytes));
+}
+
+DabMask 
+DabCache::build(int radius, int hardness, int sx, int sy){
+    DabMask m;
+    m.origin = radius + 1;
+    m.size = 2 * radius + 3;
+    m.coverage.assign(m.size * m.size, 0);
+
+    //centre in mask coordinates, pixel centres sit at +0.5
+    float cx = m.origin + static_cast<float>(sx) / SUBPIXEL;
+    float cy = m.origin + static_cast<float>(sy) / SUBPIXEL;
+    float r = static_cast<float>(radius) + 0.5f;
+
+    //hard dabs get a one pixel anti-aliased rim, soft ones fade over (1-hardness)*r
+    float falloff = std::max(1.0f, (1.0f - hardness / 100.0f) * r);
+
+    for (int y = 0; y < m.size; ++y){
+        for (int x = 0; x < m.size; ++x){
+            float dx = x + 0.5f - cx;
+            float dy = y + 0.5f - cy;
+            float t = std::clamp((r - std::sqrt(dx*dx + dy*dy)) / falloff, 0.0f, 1.0f);
+            if (falloff > 1.0f) t = t * t * (3.0f - 2.0f * t);
+            m.coverage[y * m.size + x] = static_cast<uint8_t>(t * 255.0f + 0.5f);
+        }
+    }
+    return m;
+}
@@ -0,0 +1,50 @@
+#ifndef DAB_CACHE_H
+#define DAB_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "memory.h"
+
+//coverage of one round brush stamp, size x size bytes
+struct DabMask{
+    int size = 0;
+    int origin = 0;     //mask (0,0) sits at (floor(cx) - origin, floor(cy) - origin)
+    std::vector<uint8_t> coverage;
+};
+
+//Anti-aliased round dabs are expensive to evaluate per pixel, so each
+//(radius, hardness, sub-pixel offset) combination is computed once and
+//reused by every later stamp.
+class DabCache{
+public:
+    static constexpr int SUBPIXEL = 4;          //offsets are quantized to 1/4 px
+    static constexpr int HARDNESS_STEP = 5;     //hardness 0..100 in steps of 5
+
+    static DabCache& shared();
+
+    //sx, sy in [0, SUBPIXEL). The reference stays valid until the cache has
+    //gone over budget twice more, so a caller may gather a batch of masks
+    //before using any of them.
+    const DabMask& get(int radius, int hardness, int sx, int sy);
+
+    size_t byteSize() const {return bytes + retiredBytes;}
+    void clear();
+
+private:
+    static DabMask build(int radius, int hardness, int sx, int sy);
+
+    using MaskMap = std::unordered_map<uint64_t, std::unique_ptr<DabMask>>;
+    MaskMap masks;
+    size_t bytes = 0;
+    //previous generation, freed at the next clear
+    MaskMap retired;
+    size_t retiredBytes = 0;
+    MemoryCharge charge{MemCategory::Caches, 0};
+
+    static constexpr size_t BUDGET = 32u << 20;
+};
+
+#endif
@@ -1,11 +1,48 @@
 #include <vector>
 #include <cstdint>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <climits>
 
 #include "fill.h"
 #include "canvas.h"
+#include "parallel.h"
+
+Pattern::Pattern(const std::vector<uint32_t>& pixels, int w, int h)
+    : width(w), height(h), charge(MemCategory::Caches, 0)
+{
+    int reps = (MIN_TILED + w - 1) / w + 1;
+    tiledW = w * reps;
+    tiled.resize(static_cast<size_t>(tiledW) * h);
+    for (int y = 0; y < h; ++y)
+        for (int r = 0; r < reps; ++r)
+            std::copy(pixels.begin() + static_cast<size_t>(y) * w, pixels.begin() + static_cast<size_t>(y + 1) * w,
+                      tiled.begin() + static_cast<size_t>(y) * tiledW + static_cast<size_t>(r) * w);
+    charge.resize(static_cast<int64_t>(tiled.size() * sizeof(uint32_t)));
+}
+
+void 
+Pattern::span(int y, int x, int n, uint32_t* out) const{
+    const uint32_t* row = tiled.data() + static_cast<size_t>(y % height) * tiledW;
+    int off = x % width;
+    //every chunk but the last is at least tiledW - width long
+    while (n > 0){
+        int len = std::min(n, tiledW - off);
+        std::copy(row + off, row + off + len, out);
+        out += len;
+        n -= len;
+        off = (off + len) % width;
+    }
+}
 
 Fill::Fill(uint32_t color) : color(color){}
 
+void 
+Fill::setTolerance(int t){
+    tolerance = std::clamp(t, 0, 255);
+}
+
 void 
 Fill::press(Canvas& canvas, int x, int y){
     uint32_t target = canvas.getPixel(x, y);
@@ -13,36 +50,244 @@ Fill::press(Canvas& canvas, int x, int y){
 }
 
 void 
-Fill::floodFill(Canvas& canvas, int x, int y, uint32_t target, uint32_t replacement){
-    if (target == replacement) return;
+Fill::findRegion(const Canvas& canvas, int x, int y, const ColorMatch& match, std::vector<Span>& out){
+    searchRegion(canvas, x, y, match, out, SIZE_MAX);
+}
 
+bool 
+Fill::searchRegion(const Canvas& canvas, int x, int y, const ColorMatch& match, std::vector<Span>& out, size_t maxPixels){
     int w = canvas.getWidth();
     int h = canvas.getHeight();
-    if (x < 0 || y < 0 || x >= w || y >= h) return;
-    if (canvas.getPixel(x, y) != target) return;
+    if (x < 0 || y < 0 || x >= w || y >= h) return true;
+
+    //match masks are built lazily, one whole row at a time; a run is cleared
+    //from the mask once taken, so the mask doubles as the visited set
+    std::vector<std::unique_ptr<uint8_t[]>> rows(h);
+    const uint32_t* pixels = canvas.getPixels().data();
+    size_t looked = 0;
+    auto rowMask = [&](int ry) -> uint8_t*{
+        if (!rows[ry]){
+            looked += w;
+            rows[ry].reset(new uint8_t[w]);
+            match.matchSpan(pixels + static_cast<size_t>(ry) * w, w, rows[ry].get());
+        }
+        return rows[ry].get();
+    };
 
-    struct Point {int x, y;};
-    std::vector<bool> visited(w*h, false);
-    std::vector<Point> stack;
-    stack.push_back({x, y});
-    visited[y*w + x] = true;
+    uint8_t* seedRow = rowMask(y);
+    if (!seedRow[x]) return true;
 
-    const int dx[4] = {1, -1, 0, 0};
-    const int dy[4] = {0, 0, 1, -1};
+    //grow the seed into its full run
+    int x0 = x;
+    while (x0 > 0 && seedRow[x0 - 1]) --x0;
+    int x1 = findClear(seedRow, x, w);
+    std::fill(seedRow + x0, seedRow + x1, 0);
+
+    std::vector<Span> stack;
+    stack.push_back({y, x0, x1});
 
     while (!stack.empty()){
-        Point p = stack.back(); stack.pop_back();
-        canvas.setPixel(p.x, p.y, replacement);
-
-        for (int i = 0; i < 4; ++i){
-            int nx = p.x + dx[i];
-            int ny = p.y + dy[i];
-            if (nx < 0 || ny < 0 || nx >= w || ny >= h) continue;
-            int idx = ny*w + nx;
-            if (visited[idx]) continue;
-            if (canvas.getPixel(nx, ny) != target) continue;
-            visited[idx] = true;
-            stack.push_back({nx, ny});
+        Span s = stack.back(); stack.pop_back();
+        out.push_back(s);
+        if (looked > maxPixels) return false;
+
+        for (int ny : {s.y - 1, s.y + 1}){
+            if (ny < 0 || ny >= h) continue;
+            uint8_t* m = rowMask(ny);
+
+            //every run touching [s.x0, s.x1) on the neighbour row, extended both ways
+            int cx = findSet(m, s.x0, s.x1);
+            while (cx < s.x1){
+                int rx0 = cx;
+                while (rx0 > 0 && m[rx0 - 1]) --rx0;
+                int rx1 = findClear(m, cx, w);
+                std::fill(m + rx0, m + rx1, 0);
+                stack.push_back({ny, rx0, rx1});
+                cx = findSet(m, rx1, s.x1);
+            }
         }
     }
+    return true;
+}
+
+namespace{
+
+struct Run{
+    int x0, x1;
+};
+
+uint32_t 
+findRoot(std::vector<uint32_t>& parent, uint32_t i){
+    while (parent[i] != i){
+        parent[i] = parent[parent[i]];  //path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+uint32_t 
+findRootConst(const std::vector<uint32_t>& parent, uint32_t i){
+    while (parent[i] != i) i = parent[i];
+    return i;
+}
+
+void 
+unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b){
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) parent[b] = a;
+    else if (b < a) parent[a] = b;
+}
+
+//unites every pair of overlapping runs of two vertically adjacent rows
+void 
+mergeRows(std::vector<uint32_t>& parent, const std::vector<Run>& up, uint32_t upBase,
+          const std::vector<Run>& down, uint32_t downBase){
+    size_t i = 0, j = 0;
+    while (i < up.size() && j < down.size()){
+        if (up[i].x0 < down[j].x1 && down[j].x0 < up[i].x1)
+            unite(parent, upBase + i, downBase + j);
+        if (up[i].x1 < down[j].x1) ++i;
+        else ++j;
+    }
+}
+
+} //namespace
+
+void 
+Fill::findRegionParallel(const Canvas& canvas, int x, int y, const ColorMatch& match,
+                         std::vector<Span>& out, const std::function<void(float)>& progress){
+    int w = canvas.getWidth();
+    int h = canvas.getHeight();
+    if (x < 0 || y < 0 || x >= w || y >= h) return;
+
+    const uint32_t* pixels = canvas.getPixels().data();
+    int bandRows = std::max(64, h / (parallelThreads() * 4));
+    int bands = (h + bandRows - 1) / bandRows;
+
+    std::atomic<int> rowsDone{0};
+    auto report = [&](int rows, float from, float to){
+        if (!progress) return;
+        int done = rowsDone.fetch_add(rows) + rows;
+        progress(from + (to - from) * done / h);
+    };
+
+    //1. matching runs of every row
+    std::vector<std::vector<Run>> runs(h);
+    parallelFor(0, bands, 1, [&](int b0, int b1){
+        std::vector<uint8_t> mask(w);
+        for (int b = b0; b < b1; ++b){
+            int y1 = std::min(h, (b + 1) * bandRows);
+            for (int ry = b * bandRows; ry < y1; ++ry){
+                match.matchSpan(pixels + static_cast<size_t>(ry) * w, w, mask.data());
+                for (int cx = findSet(mask.data(), 0, w); cx < w; ){
+                    int end = findClear(mask.data(), cx, w);
+                    runs[ry].push_back({cx, end});
+                    cx = findSet(mask.data(), end, w);
+                }
+            }
+            report(y1 - b * bandRows, 0.0f, 0.6f);
+        }
+    });
+
+    //2. global run ids
+    std::vector<uint32_t> base(h + 1, 0);
+    for (int ry = 0; ry < h; ++ry)
+        base[ry + 1] = base[ry] + static_cast<uint32_t>(runs[ry].size());
+
+    std::vector<uint32_t> parent(base[h]);
+    for (uint32_t i = 0; i < parent.size(); ++i) parent[i] = i;
+
+    //3. connect rows inside each band, bands own disjoint ids so no locking is needed
+    rowsDone = 0;
+    parallelFor(0, bands, 1, [&](int b0, int b1){
+        for (int b = b0; b < b1; ++b){
+            int y1 = std::min(h, (b + 1) * bandRows);
+            for (int ry = b * bandRows + 1; ry < y1; ++ry)
+                mergeRows(parent, runs[ry - 1], base[ry - 1], runs[ry], base[ry]);
+            report(y1 - b * bandRows, 0.6f, 0.8f);
+        }
+    });
+
+    //4. stitch the band borders
+    for (int b = 1; b < bands; ++b){
+        int ry = b * bandRows;
+        mergeRows(parent, runs[ry - 1], base[ry - 1], runs[ry], base[ry]);
+    }
+
+    //5. collect every run in the seed's component
+    uint32_t seed = UINT32_MAX;
+    for (size_t i = 0; i < runs[y].size(); ++i){
+        if (runs[y][i].x0 <= x && x < runs[y][i].x1){
+            seed = findRoot(parent, base[y] + static_cast<uint32_t>(i));
+            break;
+        }
+    }
+    if (seed == UINT32_MAX) return;
+
+    std::vector<std::vector<Span>> picked(bands);
+    rowsDone = 0;
+    parallelFor(0, bands, 1, [&](int b0, int b1){
+        for (int b = b0; b < b1; ++b){
+            int y1 = std::min(h, (b + 1) * bandRows);
+            for (int ry = b * bandRows; ry < y1; ++ry){
+                for (size_t i = 0; i < runs[ry].size(); ++i){
+                    if (findRootConst(parent, base[ry] + static_cast<uint32_t>(i)) == seed)
+                        picked[b].push_back({ry, runs[ry][i].x0, runs[ry][i].x1});
+                }
+            }
+            report(y1 - b * bandRows, 0.8f, 1.0f);
+        }
+    });
+
+    for (auto& p : picked)
+        out.insert(out.end(), p.begin(), p.end());
+}
+
+void 
+Fill::findRegionAuto(const Canvas& canvas, int x, int y, const ColorMatch& match,
+                     std::vector<Span>& out, const std::function<void(float)>& progress){
+    //small regions finish quickly in the serial search, huge ones go parallel
+    size_t pixelCount = static_cast<size_t>(canvas.getWidth()) * canvas.getHeight();
+    bool large = pixelCount >= PARALLEL_MIN_PIXELS;
+    if (!searchRegion(canvas, x, y, match, out, large ? SERIAL_MAX_PIXELS : SIZE_MAX)){
+        out.clear();
+        findRegionParallel(canvas, x, y, match, out, progress);
+    }
+}
+
+void 
+Fill::floodFill(Canvas& canvas, int x, int y, uint32_t target, uint32_t replacement){
+    if (target == replacement && tolerance == 0 && !pattern) return;
+
+    ColorMatch match;
+    match.target = target;
+    match.tolerance = tolerance;
+    match.mode = mode;
+
+    std::vector<Span> region;
+    findRegionAuto(canvas, x, y, match, region, progress);
+    //done however the search ended, whoever shows progress can stop
+    if (progress) progress(1.0f);
+    if (region.empty()) return;
+
+    int w = canvas.getWidth();
+    uint32_t* pixels = canvas.getPixels().data();
+    parallelFor(0, static_cast<int>(region.size()), 4096, [&](int b, int e){
+        for (int i = b; i < e; ++i){
+            const Span& s = region[i];
+            uint32_t* row = pixels + static_cast<size_t>(s.y) * w;
+            forSelected(s.y, s.x0, s.x1, [&](int a, int z){
+                if (pattern) pattern->span(s.y, a, z - a, row + a);
+                else std::fill(row + a, row + z, replacement);
+            });
+        }
+    });
+
+    int minX = w, minY = canvas.getHeight(), maxX = 0, maxY = 0;
+    for (const Span& s : region){
+        minX = std::min(minX, s.x0); maxX = std::max(maxX, s.x1);
+        minY = std::min(minY, s.y);  maxY = std::max(maxY, s.y + 1);
+    }
+    canvas.markDirty(minX, minY, maxX - minX, maxY - minY);
 }
@@ -2,20 +2,90 @@
 #define FILL_H
 
 #include <cstdint>
+#include <vector>
+#include <functional>
+#include <memory>
 
 #include "tool.h"
+#include "color_match.h"
+#include "memory.h"
+
+//Image repeated over the canvas, anchored at its origin. Rows are
+//pre-tiled to well over one period, so filling a span is a couple of long
+//copies instead of a modulo per pixel.
+class Pattern{
+public:
+    //premultiplied ARGB32
+    Pattern(const std::vector<uint32_t>& pixels, int w, int h);
+
+    void span(int y, int x, int n, uint32_t* out) const;
+
+private:
+    static constexpr int MIN_TILED = 512;
+
+    int width, height;
+    int tiledW;
+    std::vector<uint32_t> tiled;
+    MemoryCharge charge;
+};
 
 class Fill : public Tool{
 public:
     explicit Fill(uint32_t color);
     void press(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> 
+    clone() const override{
+        //replays run without progress reports
+        auto f = std::make_unique<Fill>(*this);
+        f->progress = nullptr;
+        return f;
+    }
     bool usesColor() const override {return true;}
     void setColor(uint32_t c) override {color = c;}
     uint32_t getColor() const override {return color;}
 
+    bool supportsTolerance() const override {return true;}
+    void setTolerance(int t) override;
+    int getTolerance() const override {return tolerance;}
+    void setMatchMode(MatchMode m){mode = m;}
+    //fill with a repeating image instead of the colour, null goes back to the colour
+    void setPattern(std::shared_ptr<const Pattern> p){pattern = std::move(p);}
+
+    //called with 0..1 while a large fill runs, possibly from worker threads,
+    //and with 1 once any fill is done
+    void setProgressCallback(std::function<void(float)> cb){progress = std::move(cb);}
+
+    //4-connected region of pixels matching `match`, grown from (x, y)
+    static void findRegion(const Canvas& canvas, int x, int y, const ColorMatch& match, std::vector<Span>& out);
+
+    //Same region as findRegion, computed on all cores by labelling the runs of
+    //every row in parallel bands and merging them with union-find. Scans the
+    //whole canvas, so it only pays off for regions covering much of it.
+    static void findRegionParallel(const Canvas& canvas, int x, int y, const ColorMatch& match,
+                                   std::vector<Span>& out, const std::function<void(float)>& progress = {});
+
+    //serial search first, switching to the parallel one once the region
+    //turns out to be large; what the fill itself uses
+    static void findRegionAuto(const Canvas& canvas, int x, int y, const ColorMatch& match,
+                               std::vector<Span>& out, const std::function<void(float)>& progress = {});
+
 private:
+    static bool searchRegion(const Canvas& canvas, int x, int y, const ColorMatch& match,
+                             std::vector<Span>& out, size_t maxPixels);
     void floodFill(Canvas& canvas, int x, int y, uint32_t target, uint32_t replacement);
+
+    //below this many pixels the serial search is always used
+    static constexpr size_t PARALLEL_MIN_PIXELS = 2048 * 2048;
+    //serial search gives up and hands over to the parallel one once it has
+    //looked at this many pixels; a plain region is one span per row, so
+    //counting spans would keep even a whole-canvas fill serial
+    static constexpr size_t SERIAL_MAX_PIXELS = 1 << 22;
+
     uint32_t color;
+    std::function<void(float)> progress;
+    int tolerance = 0;
+    MatchMode mode = MatchMode::PerChannel;
+    std::shared_ptr<const Pattern> pattern;
 };
 
 #endif
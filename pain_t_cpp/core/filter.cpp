@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "filter.h"
+#include "parallel.h"
+
+namespace{
+
+//one pixel as four float channels, SSE register when available
+#ifdef __SSE2__
+struct V4{
+    __m128 v;
+};
+
+inline V4 zero4(){return {_mm_setzero_ps()};}
+inline V4 add(V4 a, V4 b){return {_mm_add_ps(a.v, b.v)};}
+inline V4 sub(V4 a, V4 b){return {_mm_sub_ps(a.v, b.v)};}
+inline V4 mul(V4 a, float k){return {_mm_mul_ps(a.v, _mm_set1_ps(k))};}
+inline V4 madd(V4 acc, V4 a, float k){return {_mm_add_ps(acc.v, _mm_mul_ps(a.v, _mm_set1_ps(k)))};}
+
+inline V4 
+unpack(uint32_t px){
+    __m128i z = _mm_setzero_si128();
+    __m128i p = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(px)), z), z);
+    return {_mm_cvtepi32_ps(p)};
+}
+
+inline uint32_t 
+pack(V4 a){
+    __m128i i = _mm_cvtps_epi32(a.v);   //rounds to nearest
+    i = _mm_packs_epi32(i, i);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(i, i)));
+}
+#else
+struct V4{
+    float c[4];
+};
+
+inline V4 zero4(){return {{0, 0, 0, 0}};}
+inline V4 add(V4 a, V4 b){for (int i = 0; i < 4; ++i) a.c[i] += b.c[i]; return a;}
+inline V4 sub(V4 a, V4 b){for (int i = 0; i < 4; ++i) a.c[i] -= b.c[i]; return a;}
+inline V4 mul(V4 a, float k){for (int i = 0; i < 4; ++i) a.c[i] *= k; return a;}
+inline V4 madd(V4 acc, V4 a, float k){for (int i = 0; i < 4; ++i) acc.c[i] += a.c[i] * k; return acc;}
+
+inline V4 
+unpack(uint32_t px){
+    return {{float(px & 0xFF), float((px >> 8) & 0xFF), float((px >> 16) & 0xFF), float(px >> 24)}};
+}
+
+inline uint32_t 
+pack(V4 a){
+    uint32_t out = 0;
+    for (int i = 0; i < 4; ++i)
+        out |= static_cast<uint32_t>(std::clamp(std::lround(a.c[i]), 0L, 255L)) << (8 * i);
+    return out;
+}
+#endif
+
+//Separable pipeline: each pass maps a line of `len` samples to len - 2*halo
+//samples, so a chain of passes needs the sum of their halos around the tile.
+struct Pass{
+    int radius;         //box radius, or kernel radius for the exact path
+    bool box;
+};
+
+//running-sum box filter, out[i] = mean(in[i .. i + 2r])
+void 
+boxLine(const V4* in, int len, int stride, int r, V4* out, int outStride){
+    int n = len - 2 * r;
+    float inv = 1.0f / (2 * r + 1);
+    V4 sum = zero4();
+
+    for (int i = 0; i < n; ++i){
+        //rebuild the sum now and then so float drift cannot accumulate
+        if ((i & 255) == 0){
+            sum = zero4();
+            for (int k = 0; k <= 2 * r; ++k) sum = add(sum, in[(i + k) * stride]);
+        } else{
+            sum = add(sum, in[(i + 2 * r) * stride]);
+            sum = sub(sum, in[(i - 1) * stride]);
+        }
+        out[i * outStride] = mul(sum, inv);
+    }
+}
+
+void 
+kernelLine(const V4* in, int len, int stride, const std::vector<float>& k, V4* out, int outStride){
+    int r = static_cast<int>(k.size()) / 2;
+    int n = len - 2 * r;
+    for (int i = 0; i < n; ++i){
+        V4 acc = zero4();
+        for (int j = 0; j <= 2 * r; ++j)
+            acc = madd(acc, in[(i + j) * stride], k[j]);
+        out[i * outStride] = acc;
+    }
+}
+
+//box radii whose three-fold convolution approximates a Gaussian of this sigma
+std::vector<Pass> 
+boxesForGauss(float sigma){
+    const int n = 3;
+    float ideal = std::sqrt(12.0f * sigma * sigma / n + 1.0f);
+    int wl = static_cast<int>(std::floor(ideal));
+    if (wl % 2 == 0) --wl;
+    int wu = wl + 2;
+    float mIdeal = (12.0f * sigma * sigma - n * wl * wl - 4.0f * n * wl - 3.0f * n) / (-4.0f * wl - 4.0f);
+    int m = static_cast<int>(std::round(mIdeal));
+
+    std::vector<Pass> passes;
+    for (int i = 0; i < n; ++i)
+        passes.push_back({((i < m ? wl : wu) - 1) / 2, true});
+    return passes;
+}
+
+void 
+runPasses(Canvas& canvas, const std::vector<Pass>& passes, const std::vector<float>& kernel,
+          const Selection* selection){
+    int W = canvas.getWidth();
+    int H = canvas.getHeight();
+
+    Rect area = {0, 0, W, H};
+    //a moved selection may reach past the canvas
+    if (selection && selection->isActive()) area = selection->bounds().intersect(area);
+    if (area.empty()) return;
+
+    int halo = 0;
+    for (const Pass& p : passes) halo += p.radius;
+
+    //bigger tiles for bigger halos keep the overlap overhead bounded
+    int tile = std::max(128, 2 * halo);
+    int tilesX = (area.w + tile - 1) / tile;
+    int tilesY = (area.h + tile - 1) / tile;
+
+    //tiles read the unfiltered image, only the part within reach of the area is kept
+    int sx0 = std::max(0, area.x - halo), sx1 = std::min(W, area.x + area.w + halo);
+    int sy0 = std::max(0, area.y - halo), sy1 = std::min(H, area.y + area.h + halo);
+    int sw = sx1 - sx0;
+    std::vector<uint32_t> source(static_cast<size_t>(sw) * (sy1 - sy0));
+    for (int y = sy0; y < sy1; ++y)
+        std::memcpy(&source[static_cast<size_t>(y - sy0) * sw], canvas.getPixels().data() + static_cast<size_t>(y) * W + sx0, sw * 4);
+    uint32_t* dst = canvas.getPixels().data();
+
+    parallelFor(0, tilesX * tilesY, 1, [&](int t0, int t1){
+        std::vector<V4> a, b;
+        for (int t = t0; t < t1; ++t){
+            int tx = area.x + (t % tilesX) * tile;
+            int ty = area.y + (t / tilesX) * tile;
+            int tw = std::min(tile, area.x + area.w - tx);
+            int th = std::min(tile, area.y + area.h - ty);
+            int bw = tw + 2 * halo;
+            int bh = th + 2 * halo;
+
+            //tile plus halo, edges clamped
+            a.resize(static_cast<size_t>(bw) * bh);
+            b.resize(a.size());
+            for (int y = 0; y < bh; ++y){
+                int sy = std::clamp(ty - halo + y, sy0, sy1 - 1);
+                const uint32_t* row = source.data() + static_cast<size_t>(sy - sy0) * sw;
+                for (int x = 0; x < bw; ++x)
+                    a[y * bw + x] = unpack(row[std::clamp(tx - halo + x, sx0, sx1 - 1) - sx0]);
+            }
+
+            //horizontal passes shrink the width, every row of the buffer is kept
+            int cw = bw;
+            for (const Pass& p : passes){
+                for (int y = 0; y < bh; ++y){
+                    if (p.box) boxLine(&a[y * bw], cw, 1, p.radius, &b[y * bw], 1);
+                    else kernelLine(&a[y * bw], cw, 1, kernel, &b[y * bw], 1);
+                }
+                cw -= 2 * p.radius;
+                std::swap(a, b);
+            }
+
+            //vertical passes on the remaining tw columns
+            int ch = bh;
+            for (const Pass& p : passes){
+                for (int x = 0; x < tw; ++x){
+                    if (p.box) boxLine(&a[x], ch, bw, p.radius, &b[x], bw);
+                    else kernelLine(&a[x], ch, bw, kernel, &b[x], bw);
+                }
+                ch -= 2 * p.radius;
+                std::swap(a, b);
+            }
+
+            for (int y = 0; y < th; ++y){
+                uint32_t* out = dst + static_cast<size_t>(ty + y) * W;
+                const V4* res = &a[y * bw];
+                auto write = [&](int x0, int x1){
+                    x0 = std::max(x0, 0);
+                    x1 = std::min(x1, W);
+                    for (int x = x0; x < x1; ++x) out[x] = pack(res[x - tx]);
+                };
+                if (selection) selection->clipSpan(ty + y, tx, tx + tw, write);
+                else write(tx, tx + tw);
+            }
+        }
+    });
+
+    canvas.markDirty(area.x, area.y, area.w, area.h);
+}
+
+} //namespace
+
+void 
+Filter::boxBlur(Canvas& canvas, int radius, const Selection* selection){
+    if (radius <= 0) return;
+    runPasses(canvas, {{radius, true}}, {}, selection);
+}
+
+void 
+Filter::gaussianBlur(Canvas& canvas, float sigma, const Selection* selection){
+    if (sigma <= 0.3f) return;
+
+    if (sigma > EXACT_MAX_SIGMA){
+        runPasses(canvas, boxesForGauss(sigma), {}, selection);
+        return;
+    }
+
+    int r = static_cast<int>(std::ceil(3.0f * sigma));
+    std::vector<float> kernel(2 * r + 1);
+    float total = 0.0f;
+    for (int i = -r; i <= r; ++i){
+        kernel[i + r] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+        total += kernel[i + r];
+    }
+    for (float& k : kernel) k /= total;
+
+    runPasses(canvas, {{r, false}}, kernel, selection);
+}
@@ -0,0 +1,23 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include "canvas.h"
+#include "selection.h"
+
+//Whole-image filters. The canvas is processed in parallel tiles that read
+//a halo around themselves from the untouched source, so tiles never wait on
+//each other; results are written back only inside the selection (if any).
+class Filter{
+public:
+    //plain box blur, cost independent of radius (running sums)
+    static void boxBlur(Canvas& canvas, int radius, const Selection* selection = nullptr);
+
+    //exact separable kernel for small sigma, three running-sum box passes
+    //approximating the Gaussian above that
+    static void gaussianBlur(Canvas& canvas, float sigma, const Selection* selection = nullptr);
+
+private:
+    static constexpr float EXACT_MAX_SIGMA = 4.0f;
+};
+
+#endif
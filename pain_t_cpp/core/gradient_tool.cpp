@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "gradient_tool.h"
+#include "blend.h"
+#include "fill.h"
+#include "parallel.h"
+#include "trace.h"
+
+namespace{
+
+//8x8 Bayer thresholds scaled to 0..255, each row stored twice so any four
+//consecutive entries can be loaded in one go
+struct BayerTable{
+    uint8_t rows[8][16];
+
+    BayerTable(){
+        static const uint8_t base[8][8] = {
+            { 0, 32,  8, 40,  2, 34, 10, 42},
+            {48, 16, 56, 24, 50, 18, 58, 26},
+            {12, 44,  4, 36, 14, 46,  6, 38},
+            {60, 28, 52, 20, 62, 30, 54, 22},
+            { 3, 35, 11, 43,  1, 33,  9, 41},
+            {51, 19, 59, 27, 49, 17, 57, 25},
+            {15, 47,  7, 39, 13, 45,  5, 37},
+            {63, 31, 55, 23, 61, 29, 53, 21}
+        };
+        for (int y = 0; y < 8; ++y)
+            for (int x = 0; x < 16; ++x)
+                rows[y][x] = static_cast<uint8_t>(base[y][x & 7] * 4 + 2);
+    }
+};
+
+const BayerTable bayer;
+
+//one pixel: t in 0..256, both ends premultiplied so colour never exceeds alpha
+inline uint32_t 
+mix(uint32_t from, uint32_t to, int t, int d){
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8){
+        int a = (from >> shift) & 0xFF, b = (to >> shift) & 0xFF;
+        out |= static_cast<uint32_t>((a * (256 - t) + b * t + d) >> 8) << shift;
+    }
+    return out;
+}
+
+} //namespace
+
+GradientTool::Ramp::Ramp(Kind kind, float x0, float y0, float x1, float y1, uint32_t from, uint32_t to)
+    : kind(kind), ox(x0), oy(y0), dx(0), dy(0), invRadius(0), from(from), to(to)
+{
+    float vx = x1 - x0, vy = y1 - y0;
+    float len2 = vx*vx + vy*vy;
+    if (len2 <= 0.0f) return;
+    dx = vx / len2;
+    dy = vy / len2;
+    invRadius = 1.0f / std::sqrt(len2);
+}
+
+void 
+GradientTool::Ramp::span(int y, int x, int n, uint32_t* out) const{
+    float py = y + 0.5f - oy;
+    const uint8_t* dither = bayer.rows[y & 7];
+
+    //t = rowT + px * stepT for linear, |p - o| / r for radial
+    float rowT = py * dy;
+    float py2 = py * py;
+    auto tAt = [&](float px){
+        float t = (kind == Kind::Linear) ? rowT + px * dx : std::sqrt(px*px + py2) * invRadius;
+        return static_cast<int>(std::clamp(t, 0.0f, 1.0f) * 256.0f + 0.5f);
+    };
+
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i from16 = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(from)), zero);
+    const __m128i to16 = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<int>(to)), zero);
+    const __m128i full = _mm_set1_epi16(256);
+    const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(256.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    for (; i + 4 <= n; i += 4){
+        __m128 px = _mm_add_ps(_mm_set1_ps(x + i + 0.5f - ox), lane);
+        __m128 t;
+        if (kind == Kind::Linear){
+            t = _mm_add_ps(_mm_set1_ps(rowT), _mm_mul_ps(px, _mm_set1_ps(dx)));
+        } else{
+            t = _mm_add_ps(_mm_mul_ps(px, px), _mm_set1_ps(py2));
+            t = _mm_mul_ps(_mm_sqrt_ps(t), _mm_set1_ps(invRadius));
+        }
+        t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), one);
+        __m128i ti = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(t, scale), half));
+
+        //spread each pixel's t and dither over its four channel lanes
+        __m128i t16 = _mm_packs_epi32(ti, ti);
+        t16 = _mm_unpacklo_epi16(t16, t16);
+        int dword;
+        std::memcpy(&dword, dither + ((x + i) & 7), 4);
+        __m128i d16 = _mm_unpacklo_epi8(_mm_cvtsi32_si128(dword), zero);
+        d16 = _mm_unpacklo_epi16(d16, d16);
+
+        __m128i res[2];
+        for (int h = 0; h < 2; ++h){
+            __m128i tt = h ? _mm_unpackhi_epi32(t16, t16) : _mm_unpacklo_epi32(t16, t16);
+            __m128i dd = h ? _mm_unpackhi_epi32(d16, d16) : _mm_unpacklo_epi32(d16, d16);
+            //at most 255 * 256, fits unsigned 16 bits; dither saturates instead of wrapping
+            __m128i c = _mm_add_epi16(_mm_mullo_epi16(from16, _mm_sub_epi16(full, tt)), _mm_mullo_epi16(to16, tt));
+            res[h] = _mm_srli_epi16(_mm_adds_epu16(c, dd), 8);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(res[0], res[1]));
+    }
+#endif
+    for (; i < n; ++i){
+        int t = tAt(x + i + 0.5f - ox);
+        out[i] = mix(from, to, t, dither[(x + i) & 7]);
+    }
+}
+
+GradientTool::GradientTool(uint32_t from, uint32_t to, Kind kind)
+    : from(from), to(to), kind(kind){}
+
+void 
+GradientTool::setTolerance(int t){
+    tolerance = std::clamp(t, 0, 255);
+}
+
+void 
+GradientTool::press(Canvas&, int x, int y){
+    dragging = true;
+    painted = false;
+    startX = endX = x;
+    startY = endY = y;
+}
+
+void 
+GradientTool::drag(Canvas&, int x, int y){
+    if (!dragging) return;
+    endX = x;
+    endY = y;
+}
+
+void 
+GradientTool::release(Canvas& canvas, int x, int y){
+    if (!dragging) return;
+    dragging = false;
+    endX = x;
+    endY = y;
+    render(canvas);
+}
+
+void 
+GradientTool::render(Canvas& c){
+    TRACE_SCOPE("GradientTool::render");
+    int w = c.getWidth(), h = c.getHeight();
+    if (startX < 0 || startY < 0 || startX >= w || startY >= h) return;
+    //a plain click has no direction
+    if (startX == endX && startY == endY) return;
+
+    //rows of the region to paint, [rowStart[y], rowStart[y + 1]) into spans;
+    //no region means whole rows
+    std::vector<Span> region;
+    std::vector<int> rowStart;
+    bool useRegion = tolerance < 255 && !(selection && selection->isActive());
+    if (useRegion){
+        ColorMatch match;
+        match.target = c.getPixel(startX, startY);
+        match.tolerance = tolerance;
+        Fill::findRegionAuto(c, startX, startY, match, region);
+        if (region.empty()) return;
+        std::sort(region.begin(), region.end(), [](const Span& a, const Span& b){
+            return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+        });
+        rowStart.assign(h + 1, 0);
+        for (const Span& s : region) ++rowStart[s.y + 1];
+        for (int y = 0; y < h; ++y) rowStart[y + 1] += rowStart[y];
+    }
+
+    painted = true;
+    Ramp ramp(kind, startX + 0.5f, startY + 0.5f, endX + 0.5f, endY + 0.5f, premultiply(from), premultiply(to));
+    PixelSpanFn blend = pixelSpanKernel(mode, PixelFormat::ARGB32);
+    uint32_t* pixels = c.getPixels().data();
+    //an opaque ramp over or replacing is a plain write, skip the blend pass
+    bool direct = (ramp.from >> 24) == 255 && (ramp.to >> 24) == 255 &&
+                  (mode == BlendMode::Normal || mode == BlendMode::Replace);
+
+    parallelFor(0, h, 16, [&](int y0, int y1){
+        std::vector<uint32_t> buf(direct ? 0 : w);
+        auto paint = [&](int y, int a, int b){
+            forSelected(y, a, b, [&](int p, int q){
+                uint32_t* dst = pixels + static_cast<size_t>(y) * w + p;
+                if (direct){
+                    ramp.span(y, p, q - p, dst);
+                    return;
+                }
+                ramp.span(y, p, q - p, buf.data());
+                blend(dst, reinterpret_cast<const uint8_t*>(buf.data()), q - p);
+            });
+        };
+        for (int y = y0; y < y1; ++y){
+            if (!useRegion){
+                paint(y, 0, w);
+                continue;
+            }
+            for (int i = rowStart[y]; i < rowStart[y + 1]; ++i) paint(y, region[i].x0, region[i].x1);
+        }
+    });
+
+    if (useRegion){
+        int minX = w, maxX = 0;
+        for (const Span& s : region){
+            minX = std::min(minX, s.x0);
+            maxX = std::max(maxX, s.x1);
+        }
+        c.markDirty(minX, region.front().y, maxX - minX, region.back().y + 1 - region.front().y);
+    } else if (selection && selection->isActive()){
+        Rect b = selection->bounds();
+        c.markDirty(b.x, b.y, b.w, b.h);
+    } else{
+        c.markAllDirty();
+    }
+}
+
+void 
+GradientTool::drawOverlay(cairo_t* cr){
+    if (!dragging) return;
+
+    cairo_save(cr);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_source_rgb(cr, 0, 0, 1);
+    cairo_move_to(cr, startX + 0.5, startY + 0.5);
+    cairo_line_to(cr, endX + 0.5, endY + 0.5);
+    cairo_stroke(cr);
+    if (kind == Kind::Radial){
+        double r = std::hypot(endX - startX, endY - startY);
+        cairo_arc(cr, startX + 0.5, startY + 0.5, r, 0, 2 * M_PI);
+        cairo_stroke(cr);
+    }
+    cairo_arc(cr, startX + 0.5, startY + 0.5, 3, 0, 2 * M_PI);
+    cairo_fill(cr);
+    cairo_restore(cr);
+}
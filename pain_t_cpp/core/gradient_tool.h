@@ -0,0 +1,73 @@
+#ifndef GRADIENT_TOOL_H
+#define GRADIENT_TOOL_H
+
+#include <cstdint>
+
+#include "tool.h"
+#include "color_match.h"
+
+//Linear or radial gradient between two colours, dragged from the start
+//point to the end point. The fill is limited to the selection when one is
+//active, otherwise to the region under the start point (tolerance 255,
+//the default, takes the whole canvas).
+class GradientTool : public Tool{
+public:
+    enum class Kind{
+        Linear,
+        Radial      //centred on the start point, the end point sets the radius
+    };
+
+    GradientTool(uint32_t from, uint32_t to, Kind kind);
+
+    void press(Canvas& canvas, int x, int y) override;
+    void drag(Canvas& canvas, int x, int y) override;
+    void release(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> clone() const override{return std::make_unique<GradientTool>(*this);}
+    void drawOverlay(cairo_t* cr) override;
+    //a click without a drag, or from outside the canvas, paints nothing
+    bool editChangedPixels() const override {return painted;}
+
+    //the chooser edits the start colour
+    bool usesColor() const override {return true;}
+    void setColor(uint32_t c) override {from = c;}
+    uint32_t getColor() const override {return from;}
+
+    bool supportsBlendMode() const override {return true;}
+    void setBlendMode(BlendMode m) override {mode = m;}
+    BlendMode getBlendMode() const override {return mode;}
+
+    bool supportsTolerance() const override {return true;}
+    void setTolerance(int t) override;
+    int getTolerance() const override {return tolerance;}
+
+    //Colour ramp sampled at pixel centres, premultiplied end colours
+    //interpolated in 8.8 fixed point and ordered-dithered back to 8 bits.
+    //The dither is keyed to absolute canvas position so bands rendered
+    //separately line up.
+    struct Ramp{
+        Kind kind;
+        float ox, oy;       //start point
+        float dx, dy;       //linear: direction over length squared
+        float invRadius;    //radial
+        uint32_t from, to;
+
+        Ramp(Kind kind, float x0, float y0, float x1, float y1, uint32_t from, uint32_t to);
+        void span(int y, int x, int n, uint32_t* out) const;
+    };
+
+private:
+    void render(Canvas& canvas);
+
+    uint32_t from;
+    uint32_t to;
+    Kind kind;
+    BlendMode mode = BlendMode::Normal;
+    int tolerance = 255;
+
+    bool dragging = false;
+    bool painted = false;
+    int startX = 0, startY = 0;
+    int endX = 0, endY = 0;
+};
+
+#endif
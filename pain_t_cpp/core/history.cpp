@@ -1,77 +1,513 @@
 #include <algorithm>
+#include <chrono>
+#include <cstring>
 
 #include "history.h"
+#include "parallel.h"
+#include "profile.h"
 
-History::History(size_t maxHistory) : maxHistory(maxHistory){}
+History::History(size_t maxHistory, Mode mode) : maxHistory(std::max<size_t>(maxHistory, 2)), mode(mode){}
 
-History::Snapshot History::createSnapshot(const Canvas& canvas) const{
-    Snapshot snap;
-    snap.width  = canvas.getWidth();
-    snap.height = canvas.getHeight();
+History::~History(){
+    clear();
+}
+
+std::shared_ptr<const History::TileMap> 
+History::capture(const Canvas& canvas, const std::shared_ptr<const TileMap>& base){
+    TRACE_SCOPE("History::capture");
+    auto map = std::make_shared<TileMap>();
+    map->width = canvas.getWidth();
+    map->height = canvas.getHeight();
+    map->cols = (map->width + TILE - 1) / TILE;
+    map->rows = (map->height + TILE - 1) / TILE;
+    map->tiles.resize(static_cast<size_t>(map->cols) * map->rows);
+    bool sameSize = base && base->width == map->width && base->height == map->height;
+
+    const uint32_t* pixels = canvas.getPixels().data();
+    parallelFor(0, map->rows, 1, [&](int r0, int r1){
+        for (int r = r0; r < r1; ++r){
+            for (int c = 0; c < map->cols; ++c){
+                int x0 = c * TILE, y0 = r * TILE;
+                int w = std::min(TILE, map->width - x0), h = std::min(TILE, map->height - y0);
+                size_t i = static_cast<size_t>(r) * map->cols + c;
+                const uint32_t* src = pixels + static_cast<size_t>(y0) * map->width + x0;
+
+                //unchanged since the base, share it
+                if (sameSize){
+                    const Tile& t = *base->tiles[i];
+                    bool same = true;
+                    for (int y = 0; y < h && same; ++y){
+                        const uint32_t* row = src + static_cast<size_t>(y) * map->width;
+                        if (t.pixels.empty()) same = std::all_of(row, row + w, [&](uint32_t p){return p == t.solid;});
+                        else same = std::memcmp(row, t.pixels.data() + y * w, w * sizeof(uint32_t)) == 0;
+                    }
+                    if (same){
+                        map->tiles[i] = base->tiles[i];
+                        continue;
+                    }
+                }
+
+                auto t = std::make_shared<Tile>();
+                t->solid = src[0];
+                bool solid = true;
+                for (int y = 0; y < h && solid; ++y){
+                    const uint32_t* row = src + static_cast<size_t>(y) * map->width;
+                    solid = std::all_of(row, row + w, [&](uint32_t p){return p == t->solid;});
+                }
+                if (!solid){
+                    t->pixels.resize(static_cast<size_t>(w) * h);
+                    for (int y = 0; y < h; ++y)
+                        std::copy_n(src + static_cast<size_t>(y) * map->width, w, t->pixels.data() + y * w);
+                }
+                t->charge = MemoryCharge(MemCategory::History, static_cast<int64_t>(sizeof(Tile) + t->pixels.size() * sizeof(uint32_t)));
+                map->tiles[i] = std::move(t);
+            }
+        }
+    });
+    return map;
+}
+
+void 
+History::writeTile(Canvas& canvas, const TileMap& map, int index){
+    //clipped to the canvas, which may have been resized since the capture
+    int cw = canvas.getWidth();
+    int x0 = index % map.cols * TILE, y0 = index / map.cols * TILE;
+    int tw = std::min(TILE, map.width - x0), th = std::min(TILE, map.height - y0);
+    int w = std::min(tw, cw - x0), h = std::min(th, canvas.getHeight() - y0);
+    if (w <= 0 || h <= 0) return;
+    const Tile& t = *map.tiles[index];
+    uint32_t* dst = canvas.getPixels().data() + static_cast<size_t>(y0) * cw + x0;
+    for (int y = 0; y < h; ++y){
+        uint32_t* row = dst + static_cast<size_t>(y) * cw;
+        if (t.pixels.empty()) std::fill(row, row + w, t.solid);
+        else std::copy_n(t.pixels.data() + y * tw, w, row);
+    }
+    canvas.markDirty(x0, y0, w, h);
+}
+
+void 
+History::restore(Canvas& canvas, const std::shared_ptr<const TileMap>& map){
+    //the layer stack owns the size: a state kept at another size is cropped,
+    //and what it never covered comes back transparent
+    bool resized = canvas.getWidth() != map->width || canvas.getHeight() != map->height;
+    bool all = resized || !mirrorValid || !mirror || mirror->tiles.size() != map->tiles.size();
+    if (resized) canvas.clear(0x00000000);
+    //only tiles that differ from what the canvas holds are written
+    for (int i = 0; i < static_cast<int>(map->tiles.size()); ++i)
+        if (all || mirror->tiles[i] != map->tiles[i]) writeTile(canvas, *map, i);
+    mirror = map;
+    mirrorValid = !resized;
+}
+
+void 
+History::replay(Canvas& canvas, const Command& cmd) const{
+    //a fresh copy each time, the stored one keeps its state from before the edit
+    std::unique_ptr<Tool> tool = cmd.tool->clone();
+    tool->setSelection(nullptr);
+    tool->setSymmetry(&cmd.symmetry);
+    size_t next = 0;
+    auto settingsUpTo = [&](size_t event){
+        for (; next < cmd.settings.size() && cmd.settings[next].first <= event; ++next) cmd.settings[next].second(*tool);
+    };
+    for (size_t i = 0; i < cmd.events.size(); ++i){
+        settingsUpTo(i);
+        const InputEvent& e = cmd.events[i];
+        switch (e.kind){
+            case InputKind::Press:   tool->press(canvas, e.x, e.y); break;
+            case InputKind::Drag:    tool->drag(canvas, e.x, e.y); break;
+            case InputKind::Release: tool->release(canvas, e.x, e.y); break;
+            case InputKind::Command: break;
+        }
+    }
+    settingsUpTo(cmd.events.size());
+    if (cmd.applied) tool->apply(canvas);
+}
+
+History::Node* 
+History::addChild(Node* parent){
+    auto n = std::make_unique<Node>();
+    n->parent = parent;
+    n->serial = serial++;
+    n->x = viewX;
+    n->y = viewY;
+    Node* raw = n.get();
+    parent->children.push_back(std::move(n));
+    parent->next = raw;
+    ++count;
+    return raw;
+}
+
+bool 
+History::needsKeyframe(const Canvas& canvas, const Node* n) const{
+    if (n->tiles) return false;
+    if (mode == Mode::Snapshots || !n->replayable()) return true;
+    //commands were recorded on a canvas of the node's size
+    if (n->width != canvas.getWidth() || n->height != canvas.getHeight()) return true;
+
+    size_t steps = 0, events = 0;
+    for (const Node* p = n; !p->tiles; p = p->parent){
+        ++steps;
+        events += p->command.events.size();
+    }
+    return steps >= KEYFRAME_STEPS || events >= KEYFRAME_EVENTS;
+}
+
+void 
+History::leave(const Canvas& canvas, bool moving){
+    //the window moved on since: a state of its own where it is now, kept as
+    //shown, so what came before is undone where it was made
+    if (current->x != viewX || current->y != viewY){
+        Node* n = addChild(current);
+        n->width = canvas.getWidth();
+        n->height = canvas.getHeight();
+        n->pan = true;
+        current = n;
+        unrecorded = true;
+    }
+    //input outside any command: a state others were built on gets a new
+    //one after it, a leaf simply takes the canvas as it is now
+    if (unrecorded && !current->children.empty()){
+        Node* n = addChild(current);
+        n->width = canvas.getWidth();
+        n->height = canvas.getHeight();
+        current = n;
+    }
+    bool keep = unrecorded || needsKeyframe(canvas, current);
+    if (keep || (moving && !mirrorValid)){
+        mirror = capture(canvas, mirror);
+        mirrorValid = true;
+    }
+    if (keep) current->tiles = mirror;
+    unrecorded = false;
+    recording = nullptr;
+}
+
+void 
+History::reach(Canvas& canvas, Node* target, Node* from){
+    //nearest kept state on the way up, or `from` if that is closer
+    std::vector<Node*> down;
+    Node* n = target;
+    while (n != from && !n->tiles){
+        down.push_back(n);
+        n = n->parent;
+    }
+    if (n != from) restore(canvas, n->tiles);
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    for (size_t k = down.size(); k-- > 0;){
+        replay(canvas, down[k]->command);
+        mirrorValid = false;
+        //keep what a slow replay got to, the next visit starts from there
+        if (k > 0 && std::chrono::duration<double, std::milli>(Clock::now() - start).count() > REPLAY_BUDGET_MS){
+            mirror = capture(canvas, mirror);
+            mirrorValid = true;
+            down[k]->tiles = mirror;
+            start = Clock::now();
+        }
+    }
+}
+
+void 
+History::moveView(int x, int y, const ViewMover& move){
+    if (x == viewX && y == viewY) return;
+    if (move) move(x, y);
+    moved(x, y);
+}
 
-    const auto& pixels = canvas.getPixels();
-    snap.data.reserve(pixels.size() * 2);
+void 
+History::goTo(Canvas& canvas, Node* target, const ViewMover& move){
+    leave(canvas, true);
+
+    //the way there: up from current to the common state, then down
+    auto depth = [](const Node* n){
+        size_t d = 0;
+        for (; n->parent; n = n->parent) ++d;
+        return d;
+    };
+    std::vector<Node*> up, down;
+    Node* a = current;
+    Node* b = target;
+    size_t da = depth(a), db = depth(b);
+    for (; da > db; --da, a = a->parent) up.push_back(a);
+    for (; db > da; --db, b = b->parent) down.push_back(b);
+    for (; a != b; a = a->parent, b = b->parent){
+        up.push_back(a);
+        down.push_back(b);
+    }
+    Node* common = a;
+
+    auto here = [&](const Node* n){return n->x == viewX && n->y == viewY;};
+    if (here(common) && std::all_of(up.begin(), up.end(), here) && std::all_of(down.begin(), down.end(), here)){
+        //all made in this window, the canvas can jump straight there
+        reach(canvas, target, current);
+    } else{
+        //states made elsewhere on the board are undone and redone where they
+        //were made, a run of them at a time; pans just move the window
+        for (size_t i = 0; i < up.size();){
+            if (up[i]->pan){
+                ++i;
+                continue;
+            }
+            moveView(up[i]->x, up[i]->y, move);
+            size_t j = i + 1;
+            while (j < up.size() && !up[j]->pan) ++j;
+            reach(canvas, j < up.size() ? up[j] : common, nullptr);
+            i = j;
+        }
+        for (size_t k = down.size(); k-- > 0;){
+            Node* n = down[k];
+            moveView(n->x, n->y, move);
+            if (n->pan) continue;
+            if (n->tiles){
+                restore(canvas, n->tiles);
+            } else{
+                replay(canvas, n->command);
+                mirrorValid = false;
+            }
+        }
+        moveView(target->x, target->y, move);
+    }
 
-    // Simple RLE
-    size_t i = 0;
-    while (i < pixels.size()){
-        uint32_t pixel = pixels[i];
-        size_t run = 1;
-        while (i + run < pixels.size() && pixels[i + run] == pixel)
-            ++run;
+    //redo retraces the way just taken
+    for (Node* p = target; p->parent; p = p->parent) p->parent->next = p;
+    current = target;
+}
+
+void 
+History::trim(){
+    while (count > maxHistory && current != root.get()){
+        //states from the root to the current one stay; whatever hangs off
+        //that way goes first, the oldest subtree first
+        std::vector<Node*> path;
+        for (Node* n = current; n; n = n->parent) path.push_back(n);
+        Node* owner = nullptr;
+        size_t dead = 0;
+        for (size_t i = path.size(); i-- > 0;){
+            Node* keep = i > 0 ? path[i - 1] : nullptr;
+            auto& kids = path[i]->children;
+            for (size_t k = 0; k < kids.size(); ++k)
+                if (kids[k].get() != keep && (!owner || kids[k]->serial < owner->children[dead]->serial)){
+                    owner = path[i];
+                    dead = k;
+                }
+        }
+        if (owner){
+            size_t dropped = 0;
+            std::vector<Node*> stack{owner->children[dead].get()};
+            while (!stack.empty()){
+                Node* n = stack.back();
+                stack.pop_back();
+                ++dropped;
+                for (auto& c : n->children) stack.push_back(c.get());
+            }
+            auto& kids = owner->children;
+            bool wasNext = owner->next == kids[dead].get();
+            kids.erase(kids.begin() + dead);
+            if (wasNext){
+                //off the path only below current, any survivor will do there
+                auto on = std::find_if(kids.begin(), kids.end(), [&](const std::unique_ptr<Node>& c){
+                    return std::find(path.begin(), path.end(), c.get()) != path.end();
+                });
+                owner->next = on != kids.end() ? on->get() : kids.empty() ? nullptr : kids.back().get();
+            }
+            count -= dropped;
+            continue;
+        }
 
-        snap.data.push_back(pixel);
-        snap.data.push_back(static_cast<uint32_t>(run));
-        i += run;
+        //a single line left: the oldest state goes and the next one becomes the root
+        Node* next = path[path.size() - 2];
+        if (!next->tiles){
+            const TileMap& base = *root->tiles;
+            Canvas scratch(base.width, base.height, MemCategory::History);
+            for (int i = 0; i < static_cast<int>(base.tiles.size()); ++i) writeTile(scratch, base, i);
+            replay(scratch, next->command);
+            next->tiles = capture(scratch, root->tiles);
+        }
+        std::unique_ptr<Node> kept = std::move(root->children.front());
+        kept->parent = nullptr;
+        root = std::move(kept);
+        --count;
     }
+}
 
-    return snap;
+void 
+History::clear(){
+    //iteratively, a long chain would recurse once per node
+    std::vector<std::unique_ptr<Node>> stack;
+    if (root) stack.push_back(std::move(root));
+    while (!stack.empty()){
+        std::unique_ptr<Node> n = std::move(stack.back());
+        stack.pop_back();
+        for (auto& c : n->children) stack.push_back(std::move(c));
+    }
+    current = nullptr;
+    count = 0;
+    mirror.reset();
+    mirrorValid = false;
+    recording = nullptr;
+    unrecorded = false;
 }
 
 void 
-History::restoreSnapshot(Canvas& canvas, const Snapshot& snap) const{
-    //resize canvas properly
-    canvas.setSize(snap.width, snap.height);
-    auto& pixels = canvas.getPixels();
-    pixels.resize(snap.width * snap.height);
+History::push(const Canvas& canvas, const Tool* tool, const Symmetry* symmetry){
+    PROFILE_SCOPE(ProfileStage::History, "History::push");
+    if (!root){
+        root = std::make_unique<Node>();
+        root->width = canvas.getWidth();
+        root->height = canvas.getHeight();
+        root->serial = serial++;
+        root->x = viewX;
+        root->y = viewY;
+        root->tiles = mirror = capture(canvas, mirror);
+        current = root.get();
+        count = 1;
+    } else{
+        leave(canvas, false);
+    }
 
-    size_t out = 0;
-    for (size_t i = 0; i + 1 < snap.data.size() && out < pixels.size(); i += 2){
-        uint32_t pixel = snap.data[i];
-        uint32_t run   = snap.data[i + 1];
-        for (uint32_t r = 0; r < run && out < pixels.size(); ++r)
-            pixels[out++] = pixel;
+    Node* n = addChild(current);
+    n->width = canvas.getWidth();
+    n->height = canvas.getHeight();
+    if (mode == Mode::Commands && tool){
+        n->command.tool = tool->clone();
+        if (symmetry) n->command.symmetry = *symmetry;
+        n->command.charge = MemoryCharge(MemCategory::History, 0);
     }
+    current = n;
+    recording = tool;
+    mirrorValid = false;
+    trim();
 }
 
 void 
-History::push(const Canvas& canvas){
-    if (undoStack.size() >= maxHistory){
-        undoStack.erase(undoStack.begin());
+History::record(const Tool* tool, const InputEvent& e){
+    if (!tool->editsPixels()) return;
+    if (!current || tool != recording){
+        //this input is not in any command, the state has to be kept
+        recording = nullptr;
+        unrecorded = current != nullptr;
+        mirrorValid = false;
+        return;
     }
+    Command& cmd = current->command;
+    if (!cmd.tool) return;
+    cmd.events.push_back(e);
+    cmd.charge.resize(cmd.bytes());
+}
+
+void 
+History::recordSetting(const Tool* tool, Setting change){
+    if (!current || !tool || tool != recording || !current->command.tool) return;
+    Command& cmd = current->command;
+    cmd.settings.emplace_back(cmd.events.size(), std::move(change));
+    cmd.charge.resize(cmd.bytes());
+}
 
-    undoStack.push_back(createSnapshot(canvas));
-    redoStack.clear();
+void 
+History::applied(const Tool* tool){
+    if (tool && tool == recording){
+        current->command.applied = true;
+    } else if (tool && current && tool->editsPixels()){
+        unrecorded = true;
+        mirrorValid = false;
+    }
+    recording = nullptr;
+}
+
+void 
+History::discard(const Tool* tool){
+    //only while nothing was built on the step yet
+    if (!tool || tool != recording || !current->parent || !current->children.empty()) return;
+    Node* parent = current->parent;
+    auto& kids = parent->children;
+    kids.erase(std::find_if(kids.begin(), kids.end(), [&](const std::unique_ptr<Node>& c){return c.get() == current;}));
+    parent->next = kids.empty() ? nullptr : kids.back().get();
+    current = parent;
+    --count;
+    recording = nullptr;
+}
+
+bool 
+History::undo(Canvas& canvas, const ViewMover& move){
+    PROFILE_SCOPE(ProfileStage::History, "History::undo");
+    if (!canUndo()) return false;
+
+    //an unrecorded change on a state with branches became a state of its own,
+    //undo steps back over just that; moving the window is not an edit, undo
+    //takes back the one before it
+    Node* before = current;
+    leave(canvas, true);
+    Node* target = before;
+    if (current == before || current->pan){
+        Node* n = current;
+        while (n->pan && n->parent) n = n->parent;
+        target = n->parent ? n->parent : n;
+    }
+    goTo(canvas, target, move);
+    return true;
 }
 
 bool 
-History::undo(Canvas& canvas){
-    if (undoStack.empty()) return false;
+History::redo(Canvas& canvas, const ViewMover& move){
+    PROFILE_SCOPE(ProfileStage::History, "History::redo");
+    if (!canRedo()) return false;
 
-    redoStack.push_back(createSnapshot(canvas));
-    Snapshot snap = undoStack.back();
-    undoStack.pop_back();
-    restoreSnapshot(canvas, snap);
+    Node* target = current->next;
+    while (target->pan && target->next) target = target->next;
+    goTo(canvas, target, move);
     return true;
 }
 
 bool 
-History::redo(Canvas& canvas){
-    if (redoStack.empty()) return false;
+History::travel(Canvas& canvas, int steps, const ViewMover& move){
+    PROFILE_SCOPE(ProfileStage::History, "History::travel");
+    if (!current || steps == 0) return false;
+    leave(canvas, true);
 
-    undoStack.push_back(createSnapshot(canvas));
-    Snapshot snap = redoStack.back();
-    redoStack.pop_back();
-    restoreSnapshot(canvas, snap);
+    std::vector<Node*> all;
+    std::vector<Node*> stack{root.get()};
+    while (!stack.empty()){
+        Node* n = stack.back();
+        stack.pop_back();
+        if (!n->pan || n == current) all.push_back(n);
+        for (auto& c : n->children) stack.push_back(c.get());
+    }
+    std::sort(all.begin(), all.end(), [](const Node* a, const Node* b){return a->serial < b->serial;});
+    long at = std::find(all.begin(), all.end(), current) - all.begin();
+    long to = std::clamp(at + steps, 0L, static_cast<long>(all.size()) - 1);
+    if (to == at) return false;
+    goTo(canvas, all[to], move);
     return true;
 }
+
+bool 
+History::switchBranch(Canvas& canvas, const ViewMover& move){
+    PROFILE_SCOPE(ProfileStage::History, "History::switchBranch");
+    if (!canSwitchBranch()) return false;
+
+    Node* from = branch(current);
+    auto& kids = from->parent->children;
+    auto it = std::find_if(kids.begin(), kids.end(), [&](const std::unique_ptr<Node>& c){return c.get() == from;});
+    if (++it == kids.end()) it = kids.begin();
+    Node* target = it->get();
+    while (target->pan && target->next) target = target->next;
+    goTo(canvas, target, move);
+    return true;
+}
+
+void 
+History::settle(const Canvas& canvas){
+    //the window is only ever shown here again through history, keep it if
+    //the current state cannot be rebuilt without it
+    if (!current) return;
+    bool shown = current->x == viewX && current->y == viewY;
+    if (unrecorded || (shown && needsKeyframe(canvas, current))) leave(canvas, false);
+}
+
+void 
+History::moved(int x, int y){
+    viewX = x;
+    viewY = y;
+    mirrorValid = false;
+}
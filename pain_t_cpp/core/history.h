@@ -2,34 +2,161 @@
 #define HISTORY_H
 
 #include <vector>
+#include <memory>
 #include <cstdint>
+#include <functional>
+#include <utility>
 
 #include "canvas.h"
+#include "tool.h"
+#include "input_queue.h"
+#include "memory.h"
 
+//Undo tree. Every node is a document state, reached from its parent by one
+//edit; a new edit after an undo starts a branch instead of dropping the redo
+//steps. Kept pixels are split into tiles shared between nodes, so a state
+//only costs the tiles it changed, and moving between states only rewrites
+//tiles that differ.
+//In Snapshots mode every node keeps its pixels. In Commands mode a node
+//keeps the tool that made it and the input it received, with pixels only
+//every so often; the states in between are replayed from the nearest kept one.
+//On a board the canvas is a window that moves; every state remembers where
+//the window was, and moving to a state made elsewhere moves it back there.
 class History{
 public:
-    History(size_t maxHistory = 64);
+    enum class Mode{
+        Snapshots,
+        Commands
+    };
+
+    //change to a tool setting (colour, size...), replayed on the copy
+    using Setting = std::function<void(Tool&)>;
+    //board mode: shows the board from (x, y) in the canvas, then calls moved()
+    using ViewMover = std::function<void(int x, int y)>;
+
+    History(size_t maxHistory = 64, Mode mode = Mode::Snapshots);
+    ~History();
+
+    //an edit is about to start; in Commands mode `tool` is what makes it and
+    //is copied for replay (null, or a tool without clone(), keeps pixels instead)
+    void push(const Canvas& canvas, const Tool* tool = nullptr, const Symmetry* symmetry = nullptr);
+    //input for the tool of the last push(), any other tool ends the command
+    void record(const Tool* tool, const InputEvent& e);
+    //`change` was just made to `tool`; while it is the tool of the last
+    //push() the change is replayed at the same point of its input
+    void recordSetting(const Tool* tool, Setting change);
+    //tool is being replaced and its apply() has run on the canvas
+    void applied(const Tool* tool);
+    //the edit `tool` just made left the canvas unchanged, its step goes
+    void discard(const Tool* tool);
+
+    //`move` is only needed on a board
+    bool undo(Canvas& canvas, const ViewMover& move = {});
+    //follows the branch visited last
+    bool redo(Canvas& canvas, const ViewMover& move = {});
+    //replaces the last edit with the next alternative made from the same state
+    bool switchBranch(Canvas& canvas, const ViewMover& move = {});
+    //moves `steps` states back (negative) or forward through every state in
+    //the order they were made, whichever branch they are on
+    bool travel(Canvas& canvas, int steps, const ViewMover& move = {});
 
-    void push(const Canvas& canvas);
-    bool undo(Canvas& canvas);
-    bool redo(Canvas& canvas);
+    //board mode: the window is about to move away from what the canvas shows
+    void settle(const Canvas& canvas);
+    //board mode: the window now shows the board from (x, y)
+    void moved(int x, int y);
 
-    bool canUndo() const {return !undoStack.empty();}
-    bool canRedo() const {return !redoStack.empty();}
+    bool canUndo() const {return current && current->parent;}
+    bool canRedo() const {return current && current->next;}
+    bool canSwitchBranch() const {return current && branch(current)->parent && branch(current)->parent->children.size() > 1;}
+    void clear();
 
 private:
-    struct Snapshot{
-        std::vector<uint32_t> data;
-        int width;
-        int height;
+    static constexpr int TILE = 64;
+
+    //all `solid` when pixels is empty
+    struct Tile{
+        uint32_t solid = 0;
+        std::vector<uint32_t> pixels;
+        MemoryCharge charge;
+    };
+
+    struct TileMap{
+        int width, height;
+        int cols, rows;
+        std::vector<std::shared_ptr<const Tile>> tiles;
+    };
+
+    struct Command{
+        std::unique_ptr<Tool> tool;     //as it was when the edit began, cloned again to replay
+        Symmetry symmetry;
+        std::vector<InputEvent> events;
+        std::vector<std::pair<size_t, Setting>> settings;   //made before events[first]
+        bool applied = false;
+        MemoryCharge charge;
+
+        int64_t 
+        bytes() const{
+            return static_cast<int64_t>(events.capacity() * sizeof(InputEvent) + settings.capacity() * sizeof(settings[0]));
+        }
+    };
+
+    struct Node{
+        Node* parent = nullptr;
+        Node* next = nullptr;           //child redo goes to
+        std::vector<std::unique_ptr<Node>> children;
+        std::shared_ptr<const TileMap> tiles;   //pixels of this state, if kept
+        Command command;                        //from the parent's state to this one
+        int width, height;
+        int x = 0, y = 0;       //window position on the board
+        bool pan = false;       //only the window moved, the board is as in the parent
+        uint64_t serial;
+
+        bool replayable() const {return command.tool != nullptr;}
     };
 
-    Snapshot createSnapshot(const Canvas& canvas) const;
-    void restoreSnapshot(Canvas& canvas, const Snapshot& snap) const;
+    //Commands mode keeps pixels at least this often along a branch, so moving
+    //replays a bounded amount of input; replays that still run long leave
+    //kept states behind
+    static constexpr size_t KEYFRAME_STEPS = 32;
+    static constexpr size_t KEYFRAME_EVENTS = 8192;
+    static constexpr double REPLAY_BUDGET_MS = 50.0;
+
+    //canvas split into tiles, reusing the ones of `base` that did not change
+    static std::shared_ptr<const TileMap> capture(const Canvas& canvas, const std::shared_ptr<const TileMap>& base);
+    static void writeTile(Canvas& canvas, const TileMap& map, int index);
+
+    //where the edit leading to n branched off, above any pans in between
+    static Node* 
+    branch(Node* n){
+        while (n->parent && n->parent->pan) n = n->parent;
+        return n;
+    }
+
+    Node* addChild(Node* parent);
+    bool needsKeyframe(const Canvas& canvas, const Node* n) const;
+    void replay(Canvas& canvas, const Command& cmd) const;
+    //settles the node being left: keeps its pixels when it cannot be replayed
+    void leave(const Canvas& canvas, bool moving);
+    //restores `map` onto the canvas, which `mirror` describes
+    void restore(Canvas& canvas, const std::shared_ptr<const TileMap>& map);
+    //brings the canvas to `target`, from `from` when it shows that state
+    void reach(Canvas& canvas, Node* target, Node* from);
+    void moveView(int x, int y, const ViewMover& move);
+    void goTo(Canvas& canvas, Node* target, const ViewMover& move);
+    void trim();
 
     size_t maxHistory;
-    std::vector<Snapshot> undoStack;
-    std::vector<Snapshot> redoStack;
+    Mode mode;
+    std::unique_ptr<Node> root;
+    Node* current = nullptr;
+    size_t count = 0;
+    uint64_t serial = 0;
+    int viewX = 0, viewY = 0;
+
+    std::shared_ptr<const TileMap> mirror;  //last known content of the canvas
+    bool mirrorValid = false;               //false once the canvas may have changed since
+    const Tool* recording = nullptr;        //tool whose input goes to current
+    bool unrecorded = false;                //canvas changed outside any command since arriving at current
 };
 
 #endif
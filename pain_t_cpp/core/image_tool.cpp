@@ -2,23 +2,75 @@
 #include <algorithm>
 #include <cmath>
 #include <gdk/gdk.h>
-#include <gdk/gdkcairo.h>
 
 #include "image_tool.h"
 #include "canvas.h"
 
-ImageTool::ImageTool(GdkPixbuf* pix)
-    : pixbuf(pix)
+ImageTool::ImageTool(GdkPixbuf* pix){
+    x = 50;
+    y = 50;
+    w = srcW = gdk_pixbuf_get_width(pix);
+    h = srcH = gdk_pixbuf_get_height(pix);
+
+    //convert once, every later scale works on premultiplied ARGB
+    convertPixbuf(pix, source);
+    g_object_unref(pix);
+    account();
+}
+
+ImageTool::ImageTool(int placeholderW, int placeholderH)
+    : pending(true)
     {
     x = 50;
     y = 50;
-    w = gdk_pixbuf_get_width(pixbuf);
-    h = gdk_pixbuf_get_height(pixbuf);
+    w = placeholderW;
+    h = placeholderH;
 }
 
-ImageTool::~ImageTool(){
-    if (pixbuf)
-        g_object_unref(pixbuf);
+void 
+ImageTool::convertPixbuf(GdkPixbuf* pix, std::vector<uint32_t>& out){
+    int pw = gdk_pixbuf_get_width(pix);
+    int ph = gdk_pixbuf_get_height(pix);
+    int nChannels = gdk_pixbuf_get_n_channels(pix);
+    int rowStride = gdk_pixbuf_get_rowstride(pix);
+    const guchar* pixData = gdk_pixbuf_get_pixels(pix);
+
+    PixelSpanFn load = pixelSpanKernel(BlendMode::Replace, nChannels == 4 ? PixelFormat::RGBA8 : PixelFormat::RGB8);
+    out.assign(static_cast<size_t>(pw) * ph, 0);
+    for (int row = 0; row < ph; ++row)
+        load(out.data() + static_cast<size_t>(row) * pw, pixData + row * rowStride, pw);
+}
+
+void 
+ImageTool::setImage(std::vector<uint32_t> pixels, int imgW, int imgH){
+    source = std::move(pixels);
+    w = srcW = imgW;
+    h = srcH = imgH;
+    scaled.clear();
+    scaledW = scaledH = 0;
+    pending = false;
+    account();
+}
+
+void 
+ImageTool::account(){
+    sourceBytes.resize(static_cast<int64_t>(source.capacity() * sizeof(uint32_t)));
+    scaledBytes.resize(static_cast<int64_t>(scaled.capacity() * sizeof(uint32_t)));
+}
+
+ImageTool::~ImageTool() = default;
+
+const std::vector<uint32_t>& 
+ImageTool::scaledTo(int sw, int sh, ResampleFilter filter){
+    if (sw != scaledW || sh != scaledH || filter != scaledFilter){
+        scaled.resize(static_cast<size_t>(sw) * sh);
+        Resampler::resize(source.data(), srcW, srcH, srcW, scaled.data(), sw, sh, sw, filter);
+        scaledW = sw;
+        scaledH = sh;
+        scaledFilter = filter;
+        account();
+    }
+    return scaled;
 }
 
 void 
@@ -100,16 +152,27 @@ ImageTool::DragMode ImageTool::hitTest(int mx, int my) const{
 
 void 
 ImageTool::drawOverlay(cairo_t* cr){
-    if (!pixbuf) return;
-
-    //draw the image scaled to current w/h
-    gdk_cairo_set_source_pixbuf(
-        cr,
-        gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR),
-        x,
-        y
-    );
-    cairo_paint(cr);
+    if (pending){
+        //still decoding, show where the image will land
+        cairo_set_source_rgba(cr, 0.5, 0.5, 0.5, 0.3);
+        cairo_rectangle(cr, x, y, w, h);
+        cairo_fill(cr);
+    } else{
+        if (source.empty()) return;
+
+        //draw the image scaled to current w/h, bilinear is enough while resizing
+        const std::vector<uint32_t>& img = scaledTo(w, h, resizing() ? ResampleFilter::Bilinear : ResampleFilter::Lanczos3);
+        cairo_surface_t* surface = cairo_image_surface_create_for_data(
+            reinterpret_cast<unsigned char*>(const_cast<uint32_t*>(img.data())),
+            CAIRO_FORMAT_ARGB32,
+            w,
+            h,
+            w * 4
+        );
+        cairo_set_source_surface(cr, surface, x, y);
+        cairo_paint(cr);
+        cairo_surface_destroy(surface);
+    }
 
     //bounding box
     cairo_set_source_rgb(cr, 0, 0, 1);
@@ -131,31 +194,31 @@ ImageTool::drawOverlay(cairo_t* cr){
 
 void 
 ImageTool::apply(Canvas& canvas){
-    if (!pixbuf) return;
-
-    GdkPixbuf* scaled = gdk_pixbuf_scale_simple(pixbuf, w, h, GDK_INTERP_BILINEAR);
-    int imgW = gdk_pixbuf_get_width(scaled);
-    int imgH = gdk_pixbuf_get_height(scaled);
-    int nChannels = gdk_pixbuf_get_n_channels(scaled);
-    int rowStride = gdk_pixbuf_get_rowstride(scaled);
-    guchar* pixData = gdk_pixbuf_get_pixels(scaled);
-
-    std::vector<uint32_t> block(imgW * imgH, 0xFFFFFFFF);
-
-    for (int iy = 0; iy < imgH; ++iy){
-        for (int ix = 0; ix < imgW; ++ix) {
-            guchar* p = pixData + iy * rowStride + ix * nChannels;
-            uint8_t r = p[0];
-            uint8_t g = p[1];
-            uint8_t b = p[2];
-            uint8_t a = (nChannels == 4) ? p[3] : 255;
-            block[iy * imgW + ix] = (a << 24) | (r << 16) | (g << 8) | b;
+    if (source.empty()) return;
+
+    const std::vector<uint32_t>& img = scaledTo(w, h, ResampleFilter::Lanczos3);
+
+    //clip against the canvas, then blend whole rows with one kernel
+    int x0 = std::max(x, 0), x1 = std::min(x + w, canvas.getWidth());
+    int y0 = std::max(y, 0), y1 = std::min(y + h, canvas.getHeight());
+    if (x0 < x1 && y0 < y1){
+        PixelSpanFn span = pixelSpanKernel(mode, PixelFormat::ARGB32);
+        uint32_t* pixels = canvas.getPixels().data();
+        for (int cy = y0; cy < y1; ++cy){
+            const uint32_t* row = img.data() + static_cast<size_t>(cy - y) * w;
+            uint32_t* dst = pixels + static_cast<size_t>(cy) * canvas.getWidth();
+            forSelected(cy, x0, x1, [&](int a, int b){
+                span(dst + a, reinterpret_cast<const uint8_t*>(row + (a - x)), b - a);
+            });
         }
+        canvas.markDirty(x0, y0, x1 - x0, y1 - y0);
     }
 
-    canvas.setPixelsBlock(x, y, imgW, imgH, block);
-
-    g_object_unref(scaled); //cleanup
+    //committed, a second apply must not blend the image twice
+    std::vector<uint32_t>().swap(source);
+    std::vector<uint32_t>().swap(scaled);
+    scaledW = scaledH = 0;
+    account();
 }
 
 
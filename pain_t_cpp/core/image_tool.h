@@ -3,14 +3,25 @@
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <cairo.h>
+#include <vector>
 
 #include "tool.h"
+#include "resample.h"
+#include "memory.h"
 
 class ImageTool : public Tool{
 public:
     explicit ImageTool(GdkPixbuf* pix);
+    //placeholder of the given size until setImage delivers the pixels
+    ImageTool(int placeholderW, int placeholderH);
     ~ImageTool() override;
 
+    //premultiplied ARGB32 copy of a pixbuf, safe to call off the main thread
+    static void convertPixbuf(GdkPixbuf* pix, std::vector<uint32_t>& out);
+
+    void setImage(std::vector<uint32_t> pixels, int imgW, int imgH);
+    bool isPending() const{return pending;}
+
     void press(Canvas& canvas, int x, int y) override;
     void drag(Canvas& canvas, int x, int y) override;
     void release(Canvas& canvas, int x, int y) override;
@@ -18,6 +29,10 @@ public:
     void drawOverlay(cairo_t* cr) override;
     void apply(Canvas& canvas) override;
 
+    bool supportsBlendMode() const override{return true;}
+    void setBlendMode(BlendMode m) override{mode = m;}
+    BlendMode getBlendMode() const override{return mode;}
+
 private:
     enum class DragMode{
         None,
@@ -29,14 +44,30 @@ private:
     };
 
     DragMode hitTest(int mx, int my) const;
+    bool resizing() const{return dragMode != DragMode::None && dragMode != DragMode::Move;}
+    const std::vector<uint32_t>& scaledTo(int sw, int sh, ResampleFilter filter);
+    //reports the buffers below to MemoryStats
+    void account();
+
+    //premultiplied ARGB32 copy of the pasted image
+    std::vector<uint32_t> source;
+    int srcW = 0, srcH = 0;
+    bool pending = false;
+
+    //last resampled size, reused while the image is only moved
+    std::vector<uint32_t> scaled;
+    int scaledW = 0, scaledH = 0;
+    ResampleFilter scaledFilter = ResampleFilter::Nearest;
 
-    GdkPixbuf* pixbuf = nullptr;
+    MemoryCharge sourceBytes{MemCategory::Images, 0};
+    MemoryCharge scaledBytes{MemCategory::Images, 0};
 
     int x = 0, y = 0;
     int w = 0, h = 0;
 
     int lastX = 0, lastY = 0;
     DragMode dragMode = DragMode::None;
+    BlendMode mode = BlendMode::Normal;
 
     static constexpr int HANDLE = 8;
 };
@@ -0,0 +1,34 @@
+#include <algorithm>
+
+#include "input_queue.h"
+
+bool 
+InputQueue::push(const InputEvent& e){
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tailCache == CAPACITY){
+        tailCache = tail.load(std::memory_order_acquire);
+        if (h - tailCache == CAPACITY) return false;
+    }
+    ring[h & (CAPACITY - 1)] = e;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+size_t 
+InputQueue::pop(InputEvent* out, size_t max){
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (headCache == t){
+        headCache = head.load(std::memory_order_acquire);
+        if (headCache == t) return 0;
+    }
+    size_t n = std::min(headCache - t, max);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = ring[(t + i) & (CAPACITY - 1)];
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+bool 
+InputQueue::empty() const{
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+}
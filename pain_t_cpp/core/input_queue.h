@@ -0,0 +1,48 @@
+#ifndef INPUT_QUEUE_H
+#define INPUT_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum class InputKind : uint8_t{
+    Press,
+    Drag,
+    Release,
+    Command     //a Renderer::post payload, fetched in order when consumed
+};
+
+//One pointer event as it came from GTK. Kept small so a burst of motion
+//events is a few cache lines, not a heap allocation each.
+struct InputEvent{
+    InputKind kind;
+    int32_t x;
+    int32_t y;
+    uint32_t time;  //GDK event time in ms, for batching and replay
+};
+
+//Bounded single-producer/single-consumer ring. The GTK main loop pushes,
+//the engine pops in batches; neither side ever takes a lock.
+class InputQueue{
+public:
+    static constexpr size_t CAPACITY = 4096;   //power of two
+
+    //producer side, false when the ring is full
+    bool push(const InputEvent& e);
+
+    //consumer side, moves up to max events into out and returns how many
+    size_t pop(InputEvent* out, size_t max);
+
+    bool empty() const;
+
+private:
+    //each index on its own cache line, plus a cached copy of the other side's
+    //index so the common case touches no shared line at all
+    alignas(64) std::atomic<size_t> head{0};   //next slot to write, producer
+    size_t tailCache = 0;
+    alignas(64) std::atomic<size_t> tail{0};   //next slot to read, consumer
+    size_t headCache = 0;
+    alignas(64) InputEvent ring[CAPACITY];
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "layer_stack.h"
+#include "profile.h"
+#include "blend.h"
+#include "parallel.h"
+
+LayerStack::LayerStack(int w, int h, uint32_t background, bool board)
+    : width(w), height(h), below(w, h, MemCategory::Composite), above(w, h, MemCategory::Composite), flat(w, h, MemCategory::Composite),
+      boardMode(board)
+{
+    Layer base;
+    base.canvas = std::make_unique<Canvas>(w, h);
+    base.canvas->clear(background);
+    if (boardMode) base.board = std::make_unique<SparseCanvas>(background);
+    base.name = "Background";
+    layers.push_back(std::move(base));
+}
+
+void 
+LayerStack::setActive(size_t i){
+    if (i >= layers.size() || i == activeIdx) return;
+    activeIdx = i;
+    cachesValid = false;
+}
+
+size_t 
+LayerStack::addLayer(const std::string& name){
+    Layer l;
+    l.canvas = std::make_unique<Canvas>(width, height);
+    l.canvas->clear(0x00000000);
+    if (boardMode) l.board = std::make_unique<SparseCanvas>(0x00000000);
+    l.name = name;
+
+    activeIdx = layers.empty() ? 0 : activeIdx + 1;
+    layers.insert(layers.begin() + activeIdx, std::move(l));
+    cachesValid = false;
+    return activeIdx;
+}
+
+void 
+LayerStack::removeLayer(size_t i){
+    if (i >= layers.size() || layers.size() == 1) return;
+    layers.erase(layers.begin() + i);
+    if (activeIdx >= i && activeIdx > 0) --activeIdx;
+    cachesValid = false;
+}
+
+void 
+LayerStack::setOpacity(size_t i, uint8_t opacity){
+    if (i >= layers.size() || layers[i].opacity == opacity) return;
+    layers[i].opacity = opacity;
+    cachesValid = false;
+}
+
+void 
+LayerStack::setVisible(size_t i, bool visible){
+    if (i >= layers.size() || layers[i].visible == visible) return;
+    layers[i].visible = visible;
+    cachesValid = false;
+}
+
+void 
+LayerStack::resize(int w, int h, uint32_t background){
+    if (w == width && h == height) return;
+
+    if (boardMode){
+        storeView();
+        for (auto& l : layers) l.canvas = std::make_unique<Canvas>(w, h);
+        width = w;
+        height = h;
+        loadView();
+        below.setSize(w, h);
+        above.setSize(w, h);
+        flat.setSize(w, h);
+        cachesValid = false;
+        return;
+    }
+
+    for (size_t i = 0; i < layers.size(); ++i){
+        Canvas& old = *layers[i].canvas;
+        auto next = std::make_unique<Canvas>(w, h);
+        next->clear(i == 0 ? background : 0x00000000);
+
+        int copy_w = std::min(w, old.getWidth());
+        int copy_h = std::min(h, old.getHeight());
+        for (int y = 0; y < copy_h; y++)
+            std::copy_n(old.getPixels().data() + y * old.getWidth(),
+                        copy_w,
+                        next->getPixels().data() + y * w);
+
+        layers[i].canvas = std::move(next);
+    }
+
+    width = w;
+    height = h;
+    below.setSize(w, h);
+    above.setSize(w, h);
+    flat.setSize(w, h);
+    cachesValid = false;
+}
+
+void 
+LayerStack::storeView(){
+    for (auto& l : layers){
+        l.board->write(viewX, viewY, *l.canvas, l.unstored.unite(l.canvas->peekDirty()));
+        l.unstored = Rect();
+    }
+}
+
+void 
+LayerStack::loadView(){
+    for (auto& l : layers){
+        l.board->read(viewX, viewY, *l.canvas);
+        //straight from the board, nothing to store back
+        l.canvas->takeDirty();
+        l.unstored = Rect();
+    }
+    cachesValid = false;
+}
+
+Rect 
+LayerStack::takeDirty(Layer& l){
+    Rect r = l.canvas->takeDirty();
+    if (boardMode) l.unstored = l.unstored.unite(r);
+    return r;
+}
+
+void 
+LayerStack::pan(int dx, int dy){
+    if (!boardMode || (dx == 0 && dy == 0)) return;
+    storeView();
+
+    //nothing of the window stays in view
+    if (std::abs(dx) >= width || std::abs(dy) >= height){
+        viewX += dx;
+        viewY += dy;
+        loadView();
+        return;
+    }
+
+    //the caches slide along too unless a layer under or over changed since
+    bool keep = cachesValid;
+    for (size_t i = 0; i < layers.size() && keep; ++i)
+        if (i != activeIdx && layers[i].canvas->isDirty()) keep = false;
+
+    viewX += dx;
+    viewY += dy;
+
+    //rows coming into view, then the columns beside the rows that stay
+    int ky = std::max(0, -dy), kh = height - std::abs(dy);
+    Rect strips[2] = {
+        {0, dy > 0 ? kh : 0, width, std::abs(dy)},
+        {dx > 0 ? width - dx : 0, ky, std::abs(dx), kh},
+    };
+    for (auto& l : layers){
+        l.canvas->scroll(-dx, -dy);
+        for (const Rect& r : strips) l.board->read(viewX, viewY, *l.canvas, r);
+        //all of it gets recomposited below, and the board already has it
+        l.canvas->takeDirty();
+    }
+
+    if (!keep){
+        cachesValid = false;
+        return;
+    }
+    below.scroll(-dx, -dy);
+    above.scroll(-dx, -dy);
+    for (const Rect& r : strips){
+        flatten(below, layers, 0, activeIdx, r);
+        flatten(above, layers, activeIdx + 1, layers.size(), r);
+    }
+    scrolled = true;
+}
+
+std::shared_ptr<const std::vector<uint32_t>> 
+LayerStack::flattenBoard(int& w, int& h){
+    storeView();
+
+    //union of what was painted on any layer, or the window on an empty board
+    Rect r;
+    for (const auto& l : layers){
+        Rect b = l.board->bounds();
+        if (b.empty()) continue;
+        if (r.empty()){
+            r = b;
+            continue;
+        }
+        int x1 = std::max(r.x + r.w, b.x + b.w), y1 = std::max(r.y + r.h, b.y + b.h);
+        r.x = std::min(r.x, b.x);
+        r.y = std::min(r.y, b.y);
+        r.w = x1 - r.x;
+        r.h = y1 - r.y;
+    }
+    if (r.empty()) r = {viewX, viewY, width, height};
+
+    w = r.w;
+    h = r.h;
+
+    //only the result is held in full, layers are blended straight from their tiles
+    int64_t bytes = static_cast<int64_t>(r.w) * r.h * sizeof(uint32_t);
+    MemoryStats::add(MemCategory::Composite, bytes);
+    std::shared_ptr<std::vector<uint32_t>> out(
+        new std::vector<uint32_t>(static_cast<size_t>(r.w) * r.h, 0x00000000),
+        [bytes](std::vector<uint32_t>* p){
+            MemoryStats::add(MemCategory::Composite, -bytes);
+            delete p;
+        });
+
+    //bands of rows are independent, each walks every layer once
+    const int BAND = 64;
+    parallelFor(0, (r.h + BAND - 1) / BAND, 1, [&](int b0, int b1){
+        for (int b = b0; b < b1; ++b){
+            int y = r.y + b * BAND;
+            int bh = std::min(BAND, r.y + r.h - y);
+            uint32_t* band = out->data() + static_cast<size_t>(b) * BAND * r.w;
+            for (const auto& l : layers){
+                if (!l.visible || l.opacity == 0) continue;
+                l.board->blendOnto(r.x, y, r.w, bh, band, r.w, l.opacity);
+            }
+        }
+    });
+    return out;
+}
+
+void 
+LayerStack::flatten(Canvas& dst, const std::vector<Layer>& src, size_t from, size_t to, const Rect& r){
+    int w = dst.getWidth();
+    uint32_t* out = dst.getPixels().data();
+
+    for (int y = r.y; y < r.y + r.h; ++y){
+        size_t off = static_cast<size_t>(y) * w + r.x;
+        std::fill_n(out + off, r.w, 0x00000000);
+        for (size_t i = from; i < to; ++i){
+            if (!src[i].visible || src[i].opacity == 0) continue;
+            blendOverSpan(out + off, src[i].canvas->getPixels().data() + off, r.w, src[i].opacity);
+        }
+    }
+}
+
+void 
+LayerStack::rebuildCaches(){
+    flatten(below, layers, 0, activeIdx, {0, 0, width, height});
+    flatten(above, layers, activeIdx + 1, layers.size(), {0, 0, width, height});
+    for (auto& l : layers) takeDirty(l);
+    cachesValid = true;
+}
+
+void 
+LayerStack::compositeRegion(const Rect& r){
+    const Layer& act = layers[activeIdx];
+    bool drawActive = act.visible && act.opacity != 0;
+    bool drawAbove  = activeIdx + 1 < layers.size();
+
+    for (int y = r.y; y < r.y + r.h; ++y){
+        size_t off = static_cast<size_t>(y) * width + r.x;
+        uint32_t* out = flat.getPixels().data() + off;
+
+        std::copy_n(below.getPixels().data() + off, r.w, out);
+        if (drawActive)
+            blendOverSpan(out, act.canvas->getPixels().data() + off, r.w, act.opacity);
+        if (drawAbove)
+            blendOverSpan(out, above.getPixels().data() + off, r.w, 255);
+    }
+}
+
+const Canvas& 
+LayerStack::composite(){
+    PROFILE_SCOPE(ProfileStage::Composite, "LayerStack::composite");
+
+    //anything but the active layer changing means the pre-flattened caches are stale
+    for (size_t i = 0; i < layers.size() && cachesValid; ++i){
+        if (i != activeIdx && layers[i].canvas->isDirty())
+            cachesValid = false;
+    }
+
+    if (!cachesValid){
+        rebuildCaches();
+        damage = {0, 0, width, height};
+    } else{
+        damage = takeDirty(layers[activeIdx]);
+        //everything on screen moved
+        if (scrolled) damage = {0, 0, width, height};
+    }
+    scrolled = false;
+
+    if (!damage.empty())
+        compositeRegion(damage);
+    return flat;
+}
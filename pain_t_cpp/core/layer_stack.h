@@ -0,0 +1,92 @@
+#ifndef LAYER_STACK_H
+#define LAYER_STACK_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "canvas.h"
+#include "sparse_canvas.h"
+
+struct Layer{
+    std::unique_ptr<Canvas> canvas;
+    std::unique_ptr<SparseCanvas> board;    //whole layer in board mode, canvas is the visible part
+    Rect unstored;                          //board mode: part of canvas the board hasn't got yet
+    std::string name;
+    uint8_t opacity = 255;
+    bool visible = true;
+};
+
+//Ordered stack of canvases, index 0 is the bottom. The flattened image is
+//cached and only the region damaged on the active layer is recomposited.
+//Everything under and over the active layer is pre-flattened, so a dirty
+//pixel costs two blends no matter how many layers the document has.
+//In board mode every layer is unbounded and sparse, and the canvases only
+//hold the window onto it at origin().
+class LayerStack{
+public:
+    LayerStack(int width, int height, uint32_t background, bool board = false);
+
+    int getWidth() const {return width;}
+    int getHeight() const {return height;}
+
+    size_t count() const {return layers.size();}
+    const Layer& layer(size_t i) const {return layers[i];}
+
+    Canvas& active(){return *layers[activeIdx].canvas;}
+    size_t activeIndex() const {return activeIdx;}
+    void setActive(size_t i);
+
+    //inserts a transparent layer above the active one and activates it
+    size_t addLayer(const std::string& name);
+    void removeLayer(size_t i);
+    void setOpacity(size_t i, uint8_t opacity);
+    void setVisible(size_t i, bool visible);
+
+    //keeps the overlapping content, new area of the bottom layer gets background;
+    //in board mode nothing is cut off, the window just shows more or less
+    void resize(int w, int h, uint32_t background);
+
+    bool isBoard() const {return boardMode;}
+    int originX() const {return viewX;}
+    int originY() const {return viewY;}
+    //board mode: moves the window by (dx, dy) board pixels; what stays in
+    //view slides over, only the strips coming into view are read and flattened
+    void pan(int dx, int dy);
+    //board mode: every painted pixel of every layer, flattened
+    std::shared_ptr<const std::vector<uint32_t>> flattenBoard(int& w, int& h);
+
+    //brings the cached composite up to date and returns it
+    const Canvas& composite();
+
+    //union of the areas recomposited by the last composite() call
+    Rect lastDamage() const {return damage;}
+
+private:
+    void rebuildCaches();
+    //window to boards and back; storing only writes what changed since
+    void storeView();
+    void loadView();
+    //dirty area of a layer, also remembered as not yet stored on the board
+    Rect takeDirty(Layer& l);
+    void compositeRegion(const Rect& r);
+    static void flatten(Canvas& dst, const std::vector<Layer>& src, size_t from, size_t to, const Rect& r);
+
+    int width;
+    int height;
+    std::vector<Layer> layers;
+    size_t activeIdx = 0;
+
+    Canvas below;   //layers under the active one, flattened
+    Canvas above;   //layers over the active one, flattened onto transparent
+    Canvas flat;    //final image
+    bool cachesValid = false;
+    bool scrolled = false;  //panned with the caches kept, flat is stale everywhere
+    Rect damage;
+
+    bool boardMode;
+    int viewX = 0, viewY = 0;
+};
+
+#endif
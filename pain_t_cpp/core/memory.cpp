@@ -0,0 +1,75 @@
+#include <cstdio>
+
+#include "memory.h"
+
+namespace{
+
+constexpr int COUNT = static_cast<int>(MemCategory::Count);
+
+std::atomic<int64_t> currentBytes[COUNT];
+std::atomic<int64_t> peakBytes[COUNT];
+std::atomic<int64_t> totalBytes{0};
+std::atomic<int64_t> totalPeakBytes{0};
+
+void 
+raisePeak(std::atomic<int64_t>& peak, int64_t v){
+    int64_t p = peak.load(std::memory_order_relaxed);
+    while (v > p && !peak.compare_exchange_weak(p, v, std::memory_order_relaxed)){}
+}
+
+std::string 
+formatBytes(int64_t b){
+    char buf[32];
+    if (b >= (int64_t(1) << 30))      std::snprintf(buf, sizeof(buf), "%.2f GB", b / double(int64_t(1) << 30));
+    else if (b >= (int64_t(1) << 20)) std::snprintf(buf, sizeof(buf), "%.1f MB", b / double(1 << 20));
+    else                              std::snprintf(buf, sizeof(buf), "%.1f KB", b / 1024.0);
+    return buf;
+}
+
+} //namespace
+
+void 
+MemoryStats::add(MemCategory cat, int64_t bytes){
+    int i = static_cast<int>(cat);
+    int64_t now = currentBytes[i].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64_t all = totalBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0){
+        raisePeak(peakBytes[i], now);
+        raisePeak(totalPeakBytes, all);
+    }
+}
+
+int64_t MemoryStats::current(MemCategory cat){return currentBytes[static_cast<int>(cat)].load(std::memory_order_relaxed);}
+int64_t MemoryStats::peak(MemCategory cat){return peakBytes[static_cast<int>(cat)].load(std::memory_order_relaxed);}
+int64_t MemoryStats::total(){return totalBytes.load(std::memory_order_relaxed);}
+int64_t MemoryStats::totalPeak(){return totalPeakBytes.load(std::memory_order_relaxed);}
+
+const char* 
+MemoryStats::name(MemCategory cat){
+    switch (cat){
+        case MemCategory::Layers:    return "Layers";
+        case MemCategory::Composite: return "Composite";
+        case MemCategory::History:   return "History";
+        case MemCategory::Images:    return "Images";
+        case MemCategory::Previews:  return "Previews";
+        case MemCategory::Caches:    return "Caches";
+        case MemCategory::Clipboard: return "Clipboard";
+        default:                     return "?";
+    }
+}
+
+std::string 
+MemoryStats::report(){
+    std::string out;
+    char line[96];
+    for (int i = 0; i < COUNT; ++i){
+        MemCategory c = static_cast<MemCategory>(i);
+        std::snprintf(line, sizeof(line), "%-10s %12s   peak %12s\n", name(c),
+                      formatBytes(current(c)).c_str(), formatBytes(peak(c)).c_str());
+        out += line;
+    }
+    std::snprintf(line, sizeof(line), "%-10s %12s   peak %12s\n", "Total",
+                  formatBytes(total()).c_str(), formatBytes(totalPeak()).c_str());
+    out += line;
+    return out;
+}
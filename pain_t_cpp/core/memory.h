@@ -0,0 +1,68 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+//where the bytes go, see MemoryStats::report()
+enum class MemCategory{
+    Layers,     //layer pixels, including snapshots still pinned by history or the clipboard
+    Composite,  //LayerStack flatten caches
+    History,    //compressed undo/redo snapshots
+    Images,     //pasted images and their scaled copies
+    Previews,   //downscaled tool proxies
+    Caches,     //brush dab masks
+    Clipboard,  //pixbufs built for other applications
+    Count
+};
+
+//Process-wide byte counters with high-water marks. Subsystems report
+//through MemoryCharge, so counting is lock-free and safe from any thread.
+class MemoryStats{
+public:
+    static void add(MemCategory cat, int64_t bytes);
+
+    static int64_t current(MemCategory cat);
+    static int64_t peak(MemCategory cat);
+    static int64_t total();
+    static int64_t totalPeak();
+
+    static const char* name(MemCategory cat);
+    //one line per category plus the total, human readable
+    static std::string report();
+};
+
+//Bytes reported under a category for as long as this object lives.
+class MemoryCharge{
+public:
+    MemoryCharge() = default;
+    MemoryCharge(MemCategory c, int64_t b) : cat(c), bytes(0){resize(b);}
+    ~MemoryCharge(){resize(0);}
+
+    MemoryCharge(MemoryCharge&& o) noexcept : cat(o.cat), bytes(o.bytes){o.bytes = 0;}
+    MemoryCharge& operator=(MemoryCharge&& o) noexcept{
+        if (this != &o){
+            resize(0);
+            cat = o.cat;
+            bytes = o.bytes;
+            o.bytes = 0;
+        }
+        return *this;
+    }
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    void 
+    resize(int64_t b){
+        if (b != bytes) MemoryStats::add(cat, b - bytes);
+        bytes = b;
+    }
+    int64_t size() const {return bytes;}
+
+private:
+    MemCategory cat = MemCategory::Caches;
+    int64_t bytes = 0;
+};
+
+#endif
@@ -0,0 +1,12 @@
+#include "parallel.h"
+#include "scheduler.h"
+
+int 
+parallelThreads(){
+    return Scheduler::shared().threads();
+}
+
+void 
+parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body){
+    Scheduler::shared().parallelFor(begin, end, grain, body);
+}
@@ -0,0 +1,15 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <functional>
+
+//number of threads parallelFor spreads work over (including the caller)
+int parallelThreads();
+
+//Splits [begin, end) into chunks of `grain` items and runs body(chunkBegin, chunkEnd)
+//on the shared Scheduler pool. The calling thread takes part and the call returns
+//once every chunk is done. Chunks never overlap, so body may write to disjoint
+//rows freely. Safe to call from inside a pool task.
+void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+#endif
@@ -0,0 +1,96 @@
+#ifdef PAINT_PROFILE
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "profile.h"
+
+Profiler& 
+Profiler::shared(){
+    static Profiler instance;
+    return instance;
+}
+
+int64_t 
+Profiler::now(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void 
+Profiler::markInput(){
+    if (!pendingInput) pendingInput = now();
+}
+
+void 
+Profiler::endFrame(int64_t dirtyPixels){
+    int64_t t = now();
+    Frame current;
+    for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s)
+        current.stage[s] = pending[s].exchange(0, std::memory_order_relaxed);
+    current.frameNs = lastFrame ? t - lastFrame : 0;
+    //on_draw ending is the closest point to presentation GTK lets us see
+    current.latencyNs = pendingInput ? t - pendingInput : 0;
+    current.dirty = dirtyPixels;
+
+    frames[head] = current;
+    head = (head + 1) % FRAMES;
+    filled = std::min(filled + 1, FRAMES);
+
+    lastFrame = t;
+    pendingInput = 0;
+}
+
+void 
+Profiler::drawHud(cairo_t* cr) const{
+    if (!visible || filled == 0) return;
+
+    //averages and worst case over the rolling window
+    Frame avg, worst;
+    int withInput = 0;
+    for (int i = 0; i < filled; ++i){
+        const Frame& f = frames[i];
+        for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s){
+            avg.stage[s] += f.stage[s];
+            worst.stage[s] = std::max(worst.stage[s], f.stage[s]);
+        }
+        avg.frameNs += f.frameNs;
+        worst.frameNs = std::max(worst.frameNs, f.frameNs);
+        avg.dirty += f.dirty;
+        if (f.latencyNs){
+            avg.latencyNs += f.latencyNs;
+            worst.latencyNs = std::max(worst.latencyNs, f.latencyNs);
+            ++withInput;
+        }
+    }
+
+    auto ms = [](int64_t ns, int n){return n ? ns / 1e6 / n : 0.0;};
+    const char* names[] = {"tool", "history", "composite", "cairo", "draw"};
+
+    char lines[10][96];
+    int n = 0;
+    std::snprintf(lines[n++], sizeof(lines[0]), "frame    %6.2f ms  max %6.2f", ms(avg.frameNs, filled), ms(worst.frameNs, 1));
+    std::snprintf(lines[n++], sizeof(lines[0]), "latency  %6.2f ms  max %6.2f", ms(avg.latencyNs, withInput), ms(worst.latencyNs, 1));
+    std::snprintf(lines[n++], sizeof(lines[0]), "dirty    %8lld px/frame", static_cast<long long>(avg.dirty / filled));
+    std::snprintf(lines[n++], sizeof(lines[0]), "dropped  %8llu motion", static_cast<unsigned long long>(droppedMotion));
+    for (int s = 0; s < static_cast<int>(ProfileStage::Count); ++s)
+        std::snprintf(lines[n++], sizeof(lines[0]), "%-9s%6.2f ms  max %6.2f", names[s], ms(avg.stage[s], filled), ms(worst.stage[s], 1));
+
+    const double lineH = 14.0;
+    cairo_save(cr);
+    cairo_set_source_rgba(cr, 0, 0, 0, 0.65);
+    cairo_rectangle(cr, 8, 8, 260, n * lineH + 10);
+    cairo_fill(cr);
+
+    cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size(cr, 11.0);
+    cairo_set_source_rgb(cr, 0.6, 1.0, 0.6);
+    for (int i = 0; i < n; ++i){
+        cairo_move_to(cr, 14, 8 + lineH * (i + 1));
+        cairo_show_text(cr, lines[i]);
+    }
+    cairo_restore(cr);
+}
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cairo.h>
+
+#include "trace.h"
+
+//stages the HUD breaks a frame into
+enum class ProfileStage{
+    Tool,       //press/drag/release
+    History,    //push/undo/redo
+    Composite,  //LayerStack::composite
+    Cairo,      //painting the flattened image and overlays
+    Draw,       //all of on_draw, includes Composite and Cairo
+    Count
+};
+
+//Instrumentation only exists when built with PAINT_PROFILE (make PROFILE=1).
+//Otherwise every PROFILE_* and TRACE_* macro expands to nothing and the HUD is gone.
+#ifdef PAINT_PROFILE
+
+//Rolling per-frame timings. Stage time may be added from any thread (tools
+//run on the render thread); frames are closed and drawn on the main thread.
+class Profiler{
+public:
+    static Profiler& shared();
+
+    void add(ProfileStage stage, int64_t ns){pending[static_cast<int>(stage)].fetch_add(ns, std::memory_order_relaxed);}
+    //first input event since the last frame starts the latency clock
+    void markInput();
+    void endFrame(int64_t dirtyPixels);
+    //total motion events the input ring had to drop, shown with the timings
+    void setDroppedMotion(uint64_t n){droppedMotion = n;}
+
+    void toggle(){visible = !visible;}
+    void drawHud(cairo_t* cr) const;
+
+    static int64_t now();
+
+private:
+    struct Frame{
+        int64_t stage[static_cast<int>(ProfileStage::Count)] = {};
+        int64_t frameNs = 0;        //since the previous frame
+        int64_t latencyNs = 0;      //input to end of on_draw, 0 without input
+        int64_t dirty = 0;
+    };
+
+    static constexpr int FRAMES = 120;
+    Frame frames[FRAMES];
+    int head = 0;
+    int filled = 0;
+
+    std::atomic<int64_t> pending[static_cast<int>(ProfileStage::Count)] = {};
+    int64_t lastFrame = 0;
+    int64_t pendingInput = 0;
+    uint64_t droppedMotion = 0;
+    bool visible = false;
+};
+
+//feeds both the HUD and the trace file
+class ProfileScope{
+public:
+    ProfileScope(ProfileStage s, const char* n) : stage(s), name(n), start(Profiler::now()){}
+    ~ProfileScope(){
+        int64_t end = Profiler::now();
+        Profiler::shared().add(stage, end - start);
+        Tracer::shared().span(name, start, end);
+    }
+
+private:
+    ProfileStage stage;
+    const char* name;
+    int64_t start;
+};
+
+#define PROFILE_CAT2(a, b) a##b
+#define PROFILE_CAT(a, b) PROFILE_CAT2(a, b)
+#define PROFILE_SCOPE(stage, name) ProfileScope PROFILE_CAT(profileScope_, __LINE__)(stage, name)
+#define PROFILE_INPUT() Profiler::shared().markInput()
+#define PROFILE_FRAME(dirtyPixels) Profiler::shared().endFrame(dirtyPixels)
+#define PROFILE_DROPPED_MOTION(n) Profiler::shared().setDroppedMotion(n)
+#define PROFILE_HUD(cr) Profiler::shared().drawHud(cr)
+#define PROFILE_TOGGLE_HUD() Profiler::shared().toggle()
+
+#else
+
+#define PROFILE_SCOPE(stage, name) ((void)0)
+#define PROFILE_INPUT() ((void)0)
+#define PROFILE_FRAME(dirtyPixels) ((void)0)
+#define PROFILE_DROPPED_MOTION(n) ((void)0)
+#define PROFILE_HUD(cr) ((void)0)
+#define PROFILE_TOGGLE_HUD() ((void)0)
+
+#endif
+
+#endif
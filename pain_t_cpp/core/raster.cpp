@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "raster.h"
+
+namespace{
+
+struct Crossing{
+    float x;
+    int dir;
+};
+
+//segments for a quarter of an arc so the chord error stays under ~0.1px
+int 
+arcSegments(float radius){
+    return std::clamp(static_cast<int>(std::ceil(std::sqrt(std::max(radius, 0.0f)) * 2.0f)), 2, 64);
+}
+
+} //namespace
+
+void 
+Rasterizer::addContour(const std::vector<Point>& pts){
+    size_t n = pts.size();
+    if (n < 3) return;
+    for (size_t i = 0; i < n; ++i){
+        auto [ax, ay] = pts[i];
+        auto [bx, by] = pts[(i + 1) % n];
+        minX = std::min(minX, ax); maxX = std::max(maxX, ax);
+        minY = std::min(minY, ay); maxY = std::max(maxY, ay);
+
+        //horizontal edges never cross a sample line
+        if (ay == by) continue;
+        Edge e;
+        e.dir = (by > ay) ? 1 : -1;
+        if (by < ay){
+            std::swap(ax, bx);
+            std::swap(ay, by);
+        }
+        e.x0 = ax;
+        e.y0 = ay;
+        e.y1 = by;
+        e.dxdy = (bx - ax) / (by - ay);
+        edges.push_back(e);
+    }
+}
+
+void 
+Rasterizer::addEllipse(float cx, float cy, float rx, float ry, bool reversed){
+    if (rx <= 0.0f || ry <= 0.0f) return;
+    int n = arcSegments(std::max(rx, ry)) * 4;
+    std::vector<Point> pts(n);
+    for (int i = 0; i < n; ++i){
+        float a = 6.2831853f * i / n * (reversed ? -1.0f : 1.0f);
+        pts[i] = {cx + rx * std::cos(a), cy + ry * std::sin(a)};
+    }
+    addContour(pts);
+}
+
+void 
+Rasterizer::addCapsule(float x0, float y0, float x1, float y1, float radius){
+    float dx = x1 - x0, dy = y1 - y0;
+    float len = std::sqrt(dx*dx + dy*dy);
+    if (len < 1e-3f){
+        addEllipse(x0, y0, radius, radius);
+        return;
+    }
+
+    //half circle around each end, walked with increasing angle so every
+    //capsule winds the same way whatever the segment direction
+    float base = std::atan2(dy, dx) - 1.5707963f;
+    int n = arcSegments(radius) * 2;
+    std::vector<Point> pts;
+    pts.reserve(2 * (n + 1));
+    for (int i = 0; i <= n; ++i){
+        float a = base + 3.1415927f * i / n;
+        pts.emplace_back(x1 + radius * std::cos(a), y1 + radius * std::sin(a));
+    }
+    for (int i = 0; i <= n; ++i){
+        float a = base + 3.1415927f + 3.1415927f * i / n;
+        pts.emplace_back(x0 + radius * std::cos(a), y0 + radius * std::sin(a));
+    }
+    addContour(pts);
+}
+
+Rect 
+Rasterizer::bounds() const{
+    if (edges.empty()) return Rect();
+    int x0 = static_cast<int>(std::floor(minX)), y0 = static_cast<int>(std::floor(minY));
+    int x1 = static_cast<int>(std::ceil(maxX)) + 1, y1 = static_cast<int>(std::ceil(maxY)) + 1;
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+void 
+Rasterizer::render(int width, int height, const SpanFn& fn) const{
+    Rect b = bounds();
+    int bx0 = std::max(b.x, 0), by0 = std::max(b.y, 0);
+    int bx1 = std::min(b.x + b.w, width), by1 = std::min(b.y + b.h, height);
+    if (bx0 >= bx1 || by0 >= by1) return;
+    int bw = bx1 - bx0;
+
+    //edge list sorted by top, the active list follows the sample line down
+    std::vector<const Edge*> pending(edges.size());
+    for (size_t i = 0; i < edges.size(); ++i) pending[i] = &edges[i];
+    std::sort(pending.begin(), pending.end(), [](const Edge* a, const Edge* b){return a->y0 < b->y0;});
+    size_t next = 0;
+    std::vector<const Edge*> active;
+    std::vector<Crossing> xs;
+
+    int samples = antialias ? SUBSAMPLES : 1;
+    //each sub-scanline adds up to WEIGHT per pixel: runs through a
+    //difference array, the partial pixels at their ends directly
+    const int WEIGHT = 256 / SUBSAMPLES;
+    std::vector<int> delta, partial;
+    std::vector<uint8_t> cov;
+    if (antialias){
+        delta.assign(bw + 2, 0);
+        partial.assign(bw + 1, 0);
+        cov.assign(bw, 0);
+    }
+
+    for (int y = by0; y < by1; ++y){
+        int rowMin = bw, rowMax = -1;
+
+        for (int s = 0; s < samples; ++s){
+            float sy = y + (s + 0.5f) / samples;
+            while (next < pending.size() && pending[next]->y0 <= sy) active.push_back(pending[next++]);
+            active.erase(std::remove_if(active.begin(), active.end(), [&](const Edge* e){return e->y1 <= sy;}),
+                         active.end());
+
+            xs.clear();
+            for (const Edge* e : active) xs.push_back({e->x0 + (sy - e->y0) * e->dxdy, e->dir});
+            std::sort(xs.begin(), xs.end(), [](const Crossing& a, const Crossing& c){return a.x < c.x;});
+
+            int wind = 0;
+            float start = 0.0f;
+            for (const Crossing& c : xs){
+                int prev = wind;
+                wind += c.dir;
+                if (prev == 0 && wind != 0){
+                    start = c.x;
+                    continue;
+                }
+                if (prev == 0 || wind != 0) continue;
+
+                if (!antialias){
+                    //pixel centres inside [start, c.x)
+                    int x0 = std::max(bx0, static_cast<int>(std::ceil(start - 0.5f)));
+                    int x1 = std::min(bx1, static_cast<int>(std::ceil(c.x - 0.5f)));
+                    if (x0 < x1) fn(y, x0, x1, nullptr);
+                    continue;
+                }
+
+                float a = std::clamp(start, static_cast<float>(bx0), static_cast<float>(bx1)) - bx0;
+                float e = std::clamp(c.x, static_cast<float>(bx0), static_cast<float>(bx1)) - bx0;
+                if (a >= e) continue;
+                int ia = static_cast<int>(a), ie = static_cast<int>(e);
+                if (ia == ie){
+                    partial[ia] += static_cast<int>((e - a) * WEIGHT + 0.5f);
+                } else{
+                    partial[ia] += static_cast<int>((ia + 1 - a) * WEIGHT + 0.5f);
+                    delta[ia + 1] += WEIGHT;
+                    delta[ie] -= WEIGHT;
+                    partial[ie] += static_cast<int>((e - ie) * WEIGHT + 0.5f);
+                }
+                rowMin = std::min(rowMin, ia);
+                rowMax = std::max(rowMax, std::min(ie, bw - 1));
+            }
+        }
+        if (!antialias || rowMax < rowMin) continue;
+
+        int run = 0;
+        for (int x = rowMin; x <= rowMax; ++x){
+            run += delta[x];
+            cov[x] = static_cast<uint8_t>(std::min(255, run + partial[x]));
+        }
+        std::fill(delta.begin() + rowMin, delta.begin() + rowMax + 2, 0);
+        std::fill(partial.begin() + rowMin, partial.begin() + rowMax + 2, 0);
+
+        //solid runs go out unmasked, the fringe with its coverage
+        for (int x = rowMin; x <= rowMax;){
+            if (cov[x] == 0){
+                ++x;
+                continue;
+            }
+            bool solid = cov[x] == 255;
+            int end = x + 1;
+            while (end <= rowMax && cov[end] != 0 && (cov[end] == 255) == solid) ++end;
+            fn(y, bx0 + x, bx0 + end, solid ? nullptr : cov.data() + x);
+            x = end;
+        }
+    }
+}
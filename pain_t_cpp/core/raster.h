@@ -0,0 +1,54 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "canvas.h"
+
+//Edge-list scanline polygon rasterizer. Contours are closed and filled with
+//the non-zero rule, so overlapping pieces of a stroke (segments, caps) merge
+//instead of cancelling and an inner contour wound the other way cuts a hole.
+//Output is whole spans: fully covered runs come without a mask, only the
+//anti-aliased fringe carries per-pixel coverage.
+class Rasterizer{
+public:
+    using Point = std::pair<float, float>;
+    //coverage is null for a fully covered span, otherwise x1 - x0 bytes
+    using SpanFn = std::function<void(int y, int x0, int x1, const uint8_t* coverage)>;
+
+    explicit Rasterizer(bool antialias) : antialias(antialias){}
+
+    //points in canvas coordinates, pixel centres sit at +0.5
+    void addContour(const std::vector<Point>& pts);
+
+    //circle outline as a contour, clockwise unless reversed
+    void addEllipse(float cx, float cy, float rx, float ry, bool reversed = false);
+    //segment with round caps, radius half the width
+    void addCapsule(float x0, float y0, float x1, float y1, float radius);
+
+    bool empty() const {return edges.empty();}
+    //pixels that may be touched, unclipped
+    Rect bounds() const;
+
+    void render(int width, int height, const SpanFn& fn) const;
+
+private:
+    struct Edge{
+        float x0, y0;   //top end
+        float y1;       //bottom end
+        float dxdy;
+        int dir;        //+1 downwards in the original contour, -1 upwards
+    };
+
+    //vertical samples per pixel row when anti-aliasing
+    static constexpr int SUBSAMPLES = 4;
+
+    bool antialias;
+    std::vector<Edge> edges;
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f;
+};
+
+#endif
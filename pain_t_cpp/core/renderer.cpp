@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cstring>
+
+#include "renderer.h"
+#include "trace.h"
+
+namespace{
+
+Rect 
+unite(const Rect& a, const Rect& b){
+    if (a.empty()) return b;
+    if (b.empty()) return a;
+    int x0 = std::min(a.x, b.x), y0 = std::min(a.y, b.y);
+    int x1 = std::max(a.x + a.w, b.x + b.w), y1 = std::max(a.y + a.h, b.y + b.h);
+    return {x0, y0, x1 - x0, y1 - y0};
+}
+
+} //namespace
+
+Renderer::Renderer(std::unique_ptr<LayerStack> s, InputHandler handler, std::function<void()> ready)
+    : stack(std::move(s)), onInput(std::move(handler)), frameReady(std::move(ready))
+    {
+    thread = std::thread(&Renderer::run, this);
+}
+
+Renderer::~Renderer(){
+    {
+        std::lock_guard<std::mutex> lock(queueM);
+        stopping = true;
+    }
+    queueCv.notify_one();
+    thread.join();
+}
+
+void 
+Renderer::input(const InputEvent& e){
+    if (e.kind == InputKind::Drag && !inputs.push(e)){
+        //the engine is thousands of events behind, skipping a motion
+        //point only straightens a stroke segment
+        droppedMotion.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (e.kind != InputKind::Drag) enqueue(e);
+    wake();
+}
+
+void 
+Renderer::post(Command cmd){
+    {
+        std::lock_guard<std::mutex> lock(queueM);
+        commands.push_back(std::move(cmd));
+    }
+    enqueue({InputKind::Command, 0, 0, 0});
+    wake();
+}
+
+void 
+Renderer::enqueue(const InputEvent& e){
+    while (!inputs.push(e)) std::this_thread::yield();
+}
+
+void 
+Renderer::wake(){
+    //pairs with the fence in run(): either we see it going to sleep, or it
+    //sees what we just pushed
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!sleeping.load(std::memory_order_relaxed)) return;
+    {
+        std::lock_guard<std::mutex> lock(queueM);
+    }
+    queueCv.notify_one();
+}
+
+void 
+Renderer::requestFrame(){
+    {
+        std::lock_guard<std::mutex> lock(queueM);
+        frameWanted = true;
+    }
+    queueCv.notify_one();
+}
+
+void 
+Renderer::sync(const Command& fn){
+    {
+        std::lock_guard<std::mutex> scene(sceneM);
+        drain();
+        fn(*stack);
+    }
+    requestFrame();
+}
+
+bool 
+Renderer::trySync(const Command& fn){
+    std::unique_lock<std::mutex> scene(sceneM, std::try_to_lock);
+    if (!scene.owns_lock()) return false;
+    fn(*stack);
+    return true;
+}
+
+void 
+Renderer::drain(){
+    InputEvent batch[256];
+    while (size_t n = inputs.pop(batch, 256)){
+        TRACE_SCOPE("Renderer::drain");
+        for (size_t i = 0; i < n; ++i){
+            if (batch[i].kind != InputKind::Command){
+                onInput(*stack, batch[i]);
+                continue;
+            }
+            Command cmd;
+            {
+                std::lock_guard<std::mutex> lock(queueM);
+                cmd = std::move(commands.front());
+                commands.pop_front();
+            }
+            cmd(*stack);
+        }
+    }
+}
+
+void 
+Renderer::run(){
+    for (;;){
+        {
+            std::unique_lock<std::mutex> lock(queueM);
+            sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            queueCv.wait(lock, [&]{return stopping || frameWanted || !inputs.empty();});
+            sleeping.store(false, std::memory_order_relaxed);
+            if (stopping) return;
+            frameWanted = false;
+        }
+        {
+            //everything queued so far lands in one frame, drags coalesce for free
+            std::lock_guard<std::mutex> scene(sceneM);
+            drain();
+            publish();
+        }
+        frameReady();
+    }
+}
+
+void 
+Renderer::publish(){
+    TRACE_SCOPE("Renderer::publish");
+    const Canvas& flat = stack->composite();
+    int w = flat.getWidth(), h = flat.getHeight();
+
+    Rect damage = stack->lastDamage();
+    for (Rect& s : stale) s = unite(s, damage);
+
+    Frame& f = slots[back];
+    Rect copy = stale[back];
+    if (f.width != w || f.height != h){
+        f.pixels.assign(static_cast<size_t>(w) * h, 0);
+        f.width = w;
+        f.height = h;
+        copy = {0, 0, w, h};
+    }
+    //stale areas may predate a resize
+    int x0 = std::max(copy.x, 0), y0 = std::max(copy.y, 0);
+    int x1 = std::min(copy.x + copy.w, w), y1 = std::min(copy.y + copy.h, h);
+    copy = {x0, y0, x1 - x0, y1 - y0};
+    //only what this slot missed since it was last filled
+    const uint32_t* src = flat.getPixels().data();
+    for (int y = copy.y; !copy.empty() && y < copy.y + copy.h; ++y){
+        size_t off = static_cast<size_t>(y) * w + copy.x;
+        std::memcpy(f.pixels.data() + off, src + off, copy.w * sizeof(uint32_t));
+    }
+    f.damage = damage;
+    stale[back] = Rect();
+
+    back = middle.exchange(back | FRESH) & 3;
+}
+
+const Renderer::Frame& 
+Renderer::frame(){
+    if (middle.load() & FRESH)
+        front = middle.exchange(front) & 3;
+    return slots[front];
+}
@@ -0,0 +1,102 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "canvas.h"
+#include "input_queue.h"
+#include "layer_stack.h"
+
+//Owns the document on a dedicated render thread. The UI feeds it pointer
+//events and commands, the thread applies them in order, composites and
+//publishes the result through a triple buffer, so on_draw only ever blits
+//a finished frame and input handling never waits for rasterization.
+//input() and post() belong to the GTK main loop, it is the single producer.
+class Renderer{
+public:
+    using Command = std::function<void(LayerStack&)>;
+    using InputHandler = std::function<void(LayerStack&, const InputEvent&)>;
+
+    struct Frame{
+        std::vector<uint32_t> pixels;
+        int width = 0;
+        int height = 0;
+        Rect damage;    //area refreshed when this frame was published
+    };
+
+    //onInput applies pointer events, frameReady is called on the render
+    //thread after every publish
+    Renderer(std::unique_ptr<LayerStack> stack, InputHandler onInput, std::function<void()> frameReady);
+    ~Renderer();
+
+    Renderer(const Renderer&) = delete;
+    Renderer& operator=(const Renderer&) = delete;
+
+    //lock-free, a full ring drops motion but never presses or releases
+    void input(const InputEvent& e);
+    //motion events input() dropped so far
+    uint64_t droppedMotionEvents() const {return droppedMotion.load(std::memory_order_relaxed);}
+
+    //queued behind earlier input, runs on the render thread in posting order
+    void post(Command cmd);
+
+    //runs every queued command, then fn, on the calling thread with the
+    //document to itself. For rare edits that need an answer right away.
+    //Never call from inside a command.
+    void sync(const Command& fn);
+
+    //runs fn only if the render thread is idle right now, without draining
+    //the queue. For read-only peeks that may simply skip a frame.
+    bool trySync(const Command& fn);
+
+    //newest published frame, untouched by the render thread until the next call
+    const Frame& frame();
+
+private:
+    void run();
+    void drain();       //caller holds sceneM
+    void publish();     //caller holds sceneM
+    void requestFrame();
+    void enqueue(const InputEvent& e);
+    void wake();
+
+    std::unique_ptr<LayerStack> stack;
+    InputHandler onInput;
+    std::function<void()> frameReady;
+
+    //the ring carries the order, a Command record stands for the front of
+    //commands; consumers (render thread or sync) take turns under sceneM
+    InputQueue inputs;
+    std::atomic<bool> sleeping{false};
+    std::atomic<uint64_t> droppedMotion{0};
+
+    std::mutex queueM;
+    std::condition_variable queueCv;
+    std::deque<Command> commands;
+    bool frameWanted = true;
+    bool stopping = false;
+
+    std::mutex sceneM;
+
+    //triple buffer: the render thread fills `back`, on_draw reads `front`,
+    //the two trade through `middle`, which carries FRESH when it holds an
+    //unread frame
+    static constexpr int FRESH = 4;
+    Frame slots[3];
+    Rect stale[3];      //damage each slot has missed, render thread only
+    int back = 0;
+    int front = 1;
+    std::atomic<int> middle{2};
+
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "resample.h"
+#include "parallel.h"
+
+namespace{
+
+constexpr int PRECISION = 14;
+
+//taps of one output coordinate
+struct Contrib{
+    int start;
+    int count;
+    int offset;     //into Weights::w
+};
+
+struct Weights{
+    std::vector<Contrib> c;
+    std::vector<int16_t> w;
+};
+
+float 
+evalFilter(ResampleFilter f, float x){
+    x = std::fabs(x);
+    if (f == ResampleFilter::Bilinear) return x < 1.0f ? 1.0f - x : 0.0f;
+
+    if (x < 1e-6f) return 1.0f;
+    if (x >= 3.0f) return 0.0f;
+    const float pi = 3.14159265358979f;
+    return 3.0f * std::sin(pi * x) * std::sin(pi * x / 3.0f) / (pi * pi * x * x);
+}
+
+Weights 
+buildWeights(ResampleFilter f, int inSize, int outSize){
+    Weights out;
+    float scale = static_cast<float>(inSize) / outSize;
+    float support = (f == ResampleFilter::Lanczos3) ? 3.0f : 1.0f;
+    //when shrinking the filter is stretched so every source pixel contributes
+    float stretch = std::max(1.0f, scale);
+    support *= stretch;
+
+    std::vector<float> tmp;
+    for (int i = 0; i < outSize; ++i){
+        float centre = (i + 0.5f) * scale;
+        int lo = std::max(0, static_cast<int>(std::floor(centre - support)));
+        int hi = std::min(inSize, static_cast<int>(std::ceil(centre + support)));
+
+        tmp.clear();
+        float total = 0.0f;
+        for (int j = lo; j < hi; ++j){
+            float v = evalFilter(f, (j + 0.5f - centre) / stretch);
+            tmp.push_back(v);
+            total += v;
+        }
+        if (total == 0.0f){
+            //degenerate tiny filter, fall back to the nearest sample
+            lo = std::min(inSize - 1, static_cast<int>(centre));
+            tmp.assign(1, 1.0f);
+            total = 1.0f;
+        }
+
+        //trim zero taps on both ends
+        int a = 0, b = static_cast<int>(tmp.size());
+        while (a < b - 1 && tmp[a] == 0.0f) ++a;
+        while (b > a + 1 && tmp[b - 1] == 0.0f) --b;
+
+        Contrib c{lo + a, b - a, static_cast<int>(out.w.size())};
+        int sum = 0;
+        for (int k = a; k < b; ++k){
+            int16_t q = static_cast<int16_t>(std::lround(tmp[k] / total * (1 << PRECISION)));
+            out.w.push_back(q);
+            sum += q;
+        }
+        //push the rounding error into the largest tap so weights sum to exactly 1.0
+        auto first = out.w.begin() + c.offset;
+        *std::max_element(first, out.w.end()) += static_cast<int16_t>((1 << PRECISION) - sum);
+        //pad to an even tap count for the paired multiply-adds
+        if (c.count & 1) out.w.push_back(0);
+        out.c.push_back(c);
+    }
+    return out;
+}
+
+inline uint32_t 
+packAcc(const int32_t acc[4]){
+    uint32_t out = 0;
+    for (int k = 0; k < 4; ++k){
+        int v = (acc[k] + (1 << (PRECISION - 1))) >> PRECISION;
+        out |= static_cast<uint32_t>(std::clamp(v, 0, 255)) << (8 * k);
+    }
+    //Lanczos ringing can push a channel above alpha, keep it premultiplied
+    uint32_t a = out >> 24;
+    for (int k = 0; k < 3; ++k){
+        uint32_t c = (out >> (8 * k)) & 0xFF;
+        if (c > a) out = (out & ~(0xFFu << (8 * k))) | (a << (8 * k));
+    }
+    return out;
+}
+
+//one output pixel from `count` consecutive source pixels
+inline uint32_t 
+convolveRow(const uint32_t* in, const int16_t* w, int count){
+    int32_t acc[4] = {0, 0, 0, 0};
+    int k = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    //two taps per step: channels of both pixels interleaved, weights paired
+    for (; k + 1 < count; k += 2){
+        __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(in[k])),
+                                       _mm_cvtsi32_si128(static_cast<int>(in[k + 1])));
+        px = _mm_unpacklo_epi8(px, zero);
+        __m128i wt = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(w[k + 1])) << 16) |
+                                                     static_cast<uint16_t>(w[k])));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(px, wt));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), sum);
+#endif
+    for (; k < count; ++k)
+        for (int c = 0; c < 4; ++c)
+            acc[c] += static_cast<int32_t>((in[k] >> (8 * c)) & 0xFF) * w[k];
+    return packAcc(acc);
+}
+
+//acc[x] += rows a and b weighted, for n pixels; SSE2 handles four pixels per step
+inline void 
+accumulateRows(int32_t* acc, const uint32_t* a, int16_t wa, const uint32_t* b, int16_t wb, int n){
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wt = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(wb)) << 16) |
+                                                       static_cast<uint16_t>(wa)));
+    for (; x + 4 <= n; x += 4){
+        __m128i pa = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        __m128i pb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        __m128i lo = _mm_unpacklo_epi8(pa, pb);     //pixels 0, 1 interleaved
+        __m128i hi = _mm_unpackhi_epi8(pa, pb);     //pixels 2, 3
+        __m128i* out = reinterpret_cast<__m128i*>(acc + 4 * x);
+        _mm_storeu_si128(out + 0, _mm_add_epi32(_mm_loadu_si128(out + 0), _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), wt)));
+        _mm_storeu_si128(out + 1, _mm_add_epi32(_mm_loadu_si128(out + 1), _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), wt)));
+        _mm_storeu_si128(out + 2, _mm_add_epi32(_mm_loadu_si128(out + 2), _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), wt)));
+        _mm_storeu_si128(out + 3, _mm_add_epi32(_mm_loadu_si128(out + 3), _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), wt)));
+    }
+#endif
+    for (; x < n; ++x)
+        for (int c = 0; c < 4; ++c)
+            acc[4 * x + c] += static_cast<int32_t>((a[x] >> (8 * c)) & 0xFF) * wa +
+                              static_cast<int32_t>((b[x] >> (8 * c)) & 0xFF) * wb;
+}
+
+} //namespace
+
+void 
+Resampler::resize(const uint32_t* src, int sw, int sh, int srcStride,
+                  uint32_t* dst, int dw, int dh, int dstStride,
+                  ResampleFilter filter){
+    if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+
+    if (filter == ResampleFilter::Nearest){
+        std::vector<int> xs(dw);
+        for (int x = 0; x < dw; ++x)
+            xs[x] = std::min(sw - 1, static_cast<int>((x + 0.5f) * sw / dw));
+        parallelFor(0, dh, 32, [&](int y0, int y1){
+            for (int y = y0; y < y1; ++y){
+                const uint32_t* in = src + static_cast<size_t>(std::min(sh - 1, static_cast<int>((y + 0.5f) * sh / dh))) * srcStride;
+                uint32_t* out = dst + static_cast<size_t>(y) * dstStride;
+                for (int x = 0; x < dw; ++x) out[x] = in[xs[x]];
+            }
+        });
+        return;
+    }
+
+    Weights wx = buildWeights(filter, sw, dw);
+    Weights wy = buildWeights(filter, sh, dh);
+
+    //horizontal pass, only the source rows the vertical taps touch
+    int rowLo = wy.c.front().start;
+    int rowHi = wy.c.back().start + wy.c.back().count;
+    std::vector<uint32_t> tmp(static_cast<size_t>(dw) * (rowHi - rowLo));
+    parallelFor(rowLo, rowHi, 32, [&](int y0, int y1){
+        for (int y = y0; y < y1; ++y){
+            const uint32_t* in = src + static_cast<size_t>(y) * srcStride;
+            uint32_t* out = tmp.data() + static_cast<size_t>(y - rowLo) * dw;
+            for (int x = 0; x < dw; ++x){
+                const Contrib& c = wx.c[x];
+                out[x] = convolveRow(in + c.start, wx.w.data() + c.offset, c.count);
+            }
+        }
+    });
+
+    //vertical pass, two source rows per multiply-add
+    parallelFor(0, dh, 16, [&](int y0, int y1){
+        std::vector<int32_t> acc(static_cast<size_t>(dw) * 4);
+        for (int y = y0; y < y1; ++y){
+            const Contrib& c = wy.c[y];
+            const int16_t* w = wy.w.data() + c.offset;
+            std::fill(acc.begin(), acc.end(), 0);
+            for (int k = 0; k < c.count; k += 2){
+                const uint32_t* a = tmp.data() + static_cast<size_t>(c.start + k - rowLo) * dw;
+                //odd counts pair the last row with itself at weight 0
+                const uint32_t* b = (k + 1 < c.count) ? a + dw : a;
+                accumulateRows(acc.data(), a, w[k], b, (k + 1 < c.count) ? w[k + 1] : 0, dw);
+            }
+            uint32_t* out = dst + static_cast<size_t>(y) * dstStride;
+            for (int x = 0; x < dw; ++x) out[x] = packAcc(&acc[4 * x]);
+        }
+    });
+}
@@ -0,0 +1,24 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstdint>
+
+enum class ResampleFilter{
+    Nearest,
+    Bilinear,
+    Lanczos3
+};
+
+//Scales premultiplied ARGB32 images. Separable: a horizontal pass into a
+//temporary image, then a vertical one, both with per-coordinate weight
+//tables built once per call (14-bit fixed point) and SSE2 multiply-add
+//inner loops. Rows are split into bands that run on all cores.
+class Resampler{
+public:
+    //strides are in pixels
+    static void resize(const uint32_t* src, int sw, int sh, int srcStride,
+                       uint32_t* dst, int dw, int dh, int dstStride,
+                       ResampleFilter filter);
+};
+
+#endif
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "sample_brush.h"
+#include "blend.h"
+#include "dab_cache.h"
+
+SampleBrush::SampleBrush(Mode mode, int size)
+    : mode(mode), size(size)
+{
+    setSize(size);
+}
+
+void 
+SampleBrush::setSize(int s){
+    size = std::clamp(s, 1, 100);
+}
+
+void 
+SampleBrush::setHardness(int h){
+    hardness = std::clamp(h, 0, 100);
+}
+
+void 
+SampleBrush::press(Canvas& c, int x, int y){
+    cursorX = x;
+    cursorY = y;
+    if (mode == Mode::Clone){
+        if (!hasSource){
+            hasSource = true;
+            hasOffset = false;
+            sourceX = x;
+            sourceY = y;
+            return;
+        }
+        //the first stroke after picking fixes the offset, later strokes stay aligned
+        if (!hasOffset){
+            hasOffset = true;
+            offsetX = sourceX - x;
+            offsetY = sourceY - y;
+        }
+    }
+
+    stroking = true;
+    paint.clear();
+    carry = 0.0f;
+    lastX = static_cast<float>(x);
+    lastY = static_cast<float>(y);
+    dab(c, lastX, lastY);
+}
+
+void 
+SampleBrush::drag(Canvas& c, int x, int y){
+    cursorX = x;
+    cursorY = y;
+    if (!stroking) return;
+    stroke(c, lastX, lastY, static_cast<float>(x), static_cast<float>(y));
+    lastX = static_cast<float>(x);
+    lastY = static_cast<float>(y);
+}
+
+void 
+SampleBrush::release(Canvas&, int, int){
+    stroking = false;
+    paint.clear();
+}
+
+void 
+SampleBrush::stroke(Canvas& c, float x0, float y0, float x1, float y1){
+    //same spacing as the smooth colour brush
+    float spacing = std::max(0.5f, size * 0.25f);
+    float dx = x1 - x0;
+    float dy = y1 - y0;
+    float len = std::sqrt(dx*dx + dy*dy);
+    if (len <= 0.0f) return;
+
+    float t = spacing - carry;
+    while (t <= len){
+        dab(c, x0 + dx * t / len, y0 + dy * t / len);
+        t += spacing;
+    }
+    carry = len - (t - spacing);
+}
+
+void 
+SampleBrush::copyIn(const Canvas& c, int x, int y, int side, int stride, uint32_t* dst){
+    int w = c.getWidth(), h = c.getHeight();
+    const uint32_t* pixels = c.getPixels().data();
+    int a = std::clamp(x, 0, w), b = std::clamp(x + side, 0, w);
+    for (int ty = 0; ty < side; ++ty){
+        const uint32_t* row = pixels + static_cast<size_t>(std::clamp(y + ty, 0, h - 1)) * w;
+        uint32_t* o = dst + static_cast<size_t>(ty) * stride;
+        if (a < b){
+            std::memcpy(o + (a - x), row + a, (b - a) * sizeof(uint32_t));
+            std::fill(o, o + (a - x), row[a]);
+            std::fill(o + (b - x), o + side, row[b - 1]);
+        } else{
+            std::fill(o, o + side, row[x < 0 ? 0 : w - 1]);
+        }
+    }
+}
+
+void 
+SampleBrush::soften(const uint32_t* tile, int s, uint32_t* dst, std::vector<uint32_t>& rows){
+    int t = s + 2;
+    //(l + 2c + r) / 4 as two rounding averages, horizontally into the scratch
+    //rows then vertically; averages keep colour <= alpha
+    rows.resize(static_cast<size_t>(t) * s);
+    for (int y = 0; y < t; ++y){
+        const uint32_t* in = tile + static_cast<size_t>(y) * t + 1;
+        uint32_t* o = rows.data() + static_cast<size_t>(y) * s;
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 4 <= s; x += 4){
+            __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x - 1));
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+            __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + x), _mm_avg_epu8(_mm_avg_epu8(l, r), m));
+        }
+#endif
+        for (; x < s; ++x){
+            uint32_t v = 0;
+            for (int shift = 0; shift < 32; shift += 8){
+                uint32_t l = (in[x - 1] >> shift) & 0xFF, m = (in[x] >> shift) & 0xFF, r = (in[x + 1] >> shift) & 0xFF;
+                v |= ((((l + r + 1) >> 1) + m + 1) >> 1) << shift;
+            }
+            o[x] = v;
+        }
+    }
+    for (int y = 0; y < s; ++y){
+        const uint32_t* up = rows.data() + static_cast<size_t>(y) * s;
+        const uint32_t* mid = up + s;
+        const uint32_t* down = mid + s;
+        uint32_t* o = dst + static_cast<size_t>(y) * s;
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 4 <= s; x += 4){
+            __m128i u = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mid + x));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(down + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + x), _mm_avg_epu8(_mm_avg_epu8(u, d), m));
+        }
+#endif
+        for (; x < s; ++x){
+            uint32_t v = 0;
+            for (int shift = 0; shift < 32; shift += 8){
+                uint32_t u = (up[x] >> shift) & 0xFF, m = (mid[x] >> shift) & 0xFF, d = (down[x] >> shift) & 0xFF;
+                v |= ((((u + d + 1) >> 1) + m + 1) >> 1) << shift;
+            }
+            o[x] = v;
+        }
+    }
+}
+
+void 
+SampleBrush::dab(Canvas& c, float cx, float cy){
+    //integer input positions address pixel centres
+    cx += 0.5f;
+    cy += 0.5f;
+    float fx = std::floor(cx);
+    float fy = std::floor(cy);
+    int sx = static_cast<int>((cx - fx) * DabCache::SUBPIXEL);
+    int sy = static_cast<int>((cy - fy) * DabCache::SUBPIXEL);
+    const DabMask& m = DabCache::shared().get(size, hardness, sx, sy);
+
+    int s = m.size, t = s + 2;
+    int ox = static_cast<int>(fx) - m.origin;
+    int oy = static_cast<int>(fy) - m.origin;
+    int w = c.getWidth(), h = c.getHeight();
+    int x0 = std::max(0, ox), x1 = std::min(w, ox + s);
+    int y0 = std::max(0, oy), y1 = std::min(h, oy + s);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    size_t area = static_cast<size_t>(s) * s;
+    work.resize(static_cast<size_t>(t) * t);
+    src.resize(area);
+    out.resize(area);
+    copyIn(c, ox - 1, oy - 1, t, t, work.data());
+
+    const uint32_t* mix = src.data();
+    uint8_t strength = 255;
+    switch (mode){
+        case Mode::Soften:
+            soften(work.data(), s, src.data(), scratch);
+            break;
+        case Mode::Clone:
+            copyIn(c, ox + offsetX, oy + offsetY, s, s, src.data());
+            break;
+        case Mode::Smudge:
+            //the first dab only loads the brush
+            if (paint.size() != area){
+                paint.resize(area);
+                for (int y = 0; y < s; ++y)
+                    std::memcpy(paint.data() + static_cast<size_t>(y) * s, work.data() + static_cast<size_t>(y + 1) * t + 1, s * sizeof(uint32_t));
+                return;
+            }
+            mix = paint.data();
+            strength = SMUDGE_STRENGTH;
+            break;
+    }
+
+    const uint8_t* cov = m.coverage.data();
+    for (int y = 0; y < s; ++y){
+        const uint32_t* under = work.data() + static_cast<size_t>(y + 1) * t + 1;
+        size_t row = static_cast<size_t>(y) * s;
+        lerpMaskSpan(out.data() + row, under, mix + row, cov + row, s, strength);
+        //the load picks up some of what it passes over
+        if (mode == Mode::Smudge)
+            lerpMaskSpan(paint.data() + row, paint.data() + row, under, cov + row, s, SMUDGE_PICKUP);
+    }
+
+    //write back only the changed part of each row
+    uint32_t* pixels = c.getPixels().data();
+    int dx0 = x1, dy0 = y1, dx1 = x0, dy1 = y0;
+    for (int y = y0; y < y1; ++y){
+        const uint32_t* res = out.data() + static_cast<size_t>(y - oy) * s;
+        const uint32_t* under = work.data() + static_cast<size_t>(y - oy + 1) * t + 1;
+        int a = x0, b = x1;
+        while (a < b && res[a - ox] == under[a - ox]) ++a;
+        while (b > a && res[b - 1 - ox] == under[b - 1 - ox]) --b;
+        if (a == b) continue;
+
+        uint32_t* dst = pixels + static_cast<size_t>(y) * w;
+        forSelected(y, a, b, [&](int p, int q){
+            std::memcpy(dst + p, res + (p - ox), (q - p) * sizeof(uint32_t));
+        });
+        dx0 = std::min(dx0, a); dx1 = std::max(dx1, b);
+        dy0 = std::min(dy0, y); dy1 = std::max(dy1, y + 1);
+    }
+    c.markDirty(dx0, dy0, dx1 - dx0, dy1 - dy0);
+}
+
+void 
+SampleBrush::drawOverlay(cairo_t* cr){
+    if (mode != Mode::Clone || !hasSource) return;
+
+    //crosshair on the source, following the pointer once the offset is set
+    double x = sourceX + 0.5, y = sourceY + 0.5;
+    if (hasOffset){
+        x = cursorX + offsetX + 0.5;
+        y = cursorY + offsetY + 0.5;
+    }
+    cairo_save(cr);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_source_rgb(cr, 0, 0, 1);
+    cairo_move_to(cr, x - 6, y);
+    cairo_line_to(cr, x + 6, y);
+    cairo_move_to(cr, x, y - 6);
+    cairo_line_to(cr, x, y + 6);
+    cairo_stroke(cr);
+    cairo_restore(cr);
+}
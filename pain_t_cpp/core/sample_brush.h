@@ -0,0 +1,83 @@
+#ifndef SAMPLE_BRUSH_H
+#define SAMPLE_BRUSH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "tool.h"
+
+struct DabMask;
+
+//Brushes that paint with the canvas itself instead of a colour. Each dab
+//copies its neighbourhood into a small working tile, runs the kernel
+//there and writes back only the spans that changed, so the per-pixel
+//work never goes through Canvas::getPixel/setPixel.
+class SampleBrush : public Tool{
+public:
+    enum class Mode{
+        Smudge,     //drags paint picked up along the stroke
+        Soften,     //local blur under the dab
+        Clone       //first click sets the source, strokes copy from it at a fixed offset
+    };
+
+    SampleBrush(Mode mode, int size = 12);
+
+    void press(Canvas& canvas, int x, int y) override;
+    void drag(Canvas& canvas, int x, int y) override;
+    void release(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> 
+    clone() const override{
+        //settings and clone source only, the first dab sizes new working tiles
+        auto b = std::make_unique<SampleBrush>(*this);
+        for (auto* v : {&b->work, &b->src, &b->scratch, &b->out, &b->paint}) std::vector<uint32_t>().swap(*v);
+        return b;
+    }
+    void drawOverlay(cairo_t* cr) override;
+
+    //setting the clone source paints nothing
+    bool beginsEdit() const override {return mode != Mode::Clone || hasSource;}
+
+    bool supportsSize() const override {return true;}
+    void setSize(int s) override;
+    int getSize() const override {return size;}
+
+    bool supportsHardness() const override {return true;}
+    bool getAntialias() const override {return true;}
+    void setHardness(int h) override;
+    int getHardness() const override {return hardness;}
+
+private:
+    void stroke(Canvas& c, float x0, float y0, float x1, float y1);
+    void dab(Canvas& c, float cx, float cy);
+
+    //tile side pixels copied from (x, y), canvas edges repeated outwards
+    static void copyIn(const Canvas& c, int x, int y, int side, int stride, uint32_t* out);
+    //[1 2 1] filter in both directions over the interior of an (s+2) tile
+    static void soften(const uint32_t* tile, int s, uint32_t* out, std::vector<uint32_t>& scratch);
+
+    static constexpr uint8_t SMUDGE_STRENGTH = 200;
+    static constexpr uint8_t SMUDGE_PICKUP = 80;
+
+    Mode mode;
+    int size;
+    int hardness = 50;
+
+    float lastX = 0, lastY = 0;
+    float carry = 0.0f;
+    bool stroking = false;
+
+    bool hasSource = false;
+    int sourceX = 0, sourceY = 0;
+    bool hasOffset = false;
+    int offsetX = 0, offsetY = 0;   //source minus destination, fixed by the first stroke
+    int cursorX = 0, cursorY = 0;
+
+    //working tiles, kept between dabs so a stroke allocates once
+    std::vector<uint32_t> work;     //(s+2)^2 canvas copy around the dab
+    std::vector<uint32_t> src;      //s^2 what the dab mixes in
+    std::vector<uint32_t> scratch;  //(s+2)*s soften rows
+    std::vector<uint32_t> out;      //s^2 result
+    std::vector<uint32_t> paint;    //s^2 smudge load, empty until the first dab of a stroke
+};
+
+#endif
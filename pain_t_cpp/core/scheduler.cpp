@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <glib.h>
+
+#include "scheduler.h"
+#include "trace.h"
+
+namespace{
+
+//index of the worker running on this thread, -1 elsewhere
+thread_local int workerIndex = -1;
+
+gboolean 
+runPosted(gpointer data){
+    (*static_cast<std::function<void()>*>(data))();
+    return G_SOURCE_REMOVE;
+}
+
+void 
+freePosted(gpointer data){
+    delete static_cast<std::function<void()>*>(data);
+}
+
+} //namespace
+
+void 
+runOnMainLoop(std::function<void()> fn){
+    g_idle_add_full(G_PRIORITY_DEFAULT, runPosted, new std::function<void()>(std::move(fn)), freePosted);
+}
+
+Scheduler& 
+Scheduler::shared(){
+    static Scheduler instance(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())) - 1);
+    return instance;
+}
+
+Scheduler::Scheduler(int workerCount){
+    for (int i = 0; i < workerCount; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < workerCount; ++i)
+        workers[i]->thread = std::thread(&Scheduler::run, this, i);
+}
+
+Scheduler::~Scheduler(){
+    {
+        std::lock_guard<std::mutex> lock(sleepM);
+        stopping = true;
+    }
+    sleepCv.notify_all();
+    for (auto& w : workers) w->thread.join();
+}
+
+void 
+Scheduler::push(int target, Task task){
+    {
+        std::lock_guard<std::mutex> lock(workers[target]->m);
+        workers[target]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepM);
+        queued.fetch_add(1);
+    }
+    sleepCv.notify_one();
+}
+
+void 
+Scheduler::submit(std::function<void()> task){
+    if (workers.empty()){
+        //single core, nothing to hand the task to
+        task();
+        return;
+    }
+    //workers keep their own spawns local, other threads spread round robin
+    int target = workerIndex >= 0 ? workerIndex : static_cast<int>(nextTarget.fetch_add(1) % workers.size());
+    push(target, std::move(task));
+}
+
+bool 
+Scheduler::findTask(int self, Task& out){
+    int n = static_cast<int>(workers.size());
+    if (self >= 0){
+        Worker& own = *workers[self];
+        std::lock_guard<std::mutex> lock(own.m);
+        if (!own.tasks.empty()){
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    //steal the oldest task of someone else
+    int start = self >= 0 ? self + 1 : 0;
+    for (int k = 0; k < n; ++k){
+        Worker& victim = *workers[(start + k) % n];
+        std::lock_guard<std::mutex> lock(victim.m);
+        if (!victim.tasks.empty()){
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void 
+Scheduler::run(int self){
+    workerIndex = self;
+    for (;;){
+        Task task;
+        if (findTask(self, task)){
+            TRACE_SCOPE("Scheduler task");
+            task();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepM);
+        sleepCv.wait(lock, [&]{return stopping || queued.load() > 0;});
+        if (stopping) return;
+    }
+}
+
+void 
+Scheduler::parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body){
+    if (end <= begin) return;
+    grain = std::max(grain, 1);
+
+    int chunks = (end - begin + grain - 1) / grain;
+    int helpers = std::min(threads(), chunks) - 1;
+    if (helpers <= 0){
+        body(begin, end);
+        return;
+    }
+
+    //chunks are claimed dynamically, uneven rows do not stall the others.
+    //The state outlives this call because helpers may start after it returns;
+    //they only touch body after claiming a chunk, which is then waited for.
+    struct Shared{
+        std::atomic<int> next{0};
+        std::atomic<int> active{0};
+    };
+    auto shared = std::make_shared<Shared>();
+    const std::function<void(int, int)>* fn = &body;
+
+    auto claimLoop = [=](){
+        for (int c = shared->next.fetch_add(1); c < chunks; c = shared->next.fetch_add(1)){
+            TRACE_SCOPE("parallelFor chunk");
+            int b = begin + c * grain;
+            (*fn)(b, std::min(b + grain, end));
+        }
+    };
+
+    for (int i = 0; i < helpers; ++i)
+        submit([shared, claimLoop]{
+            shared->active.fetch_add(1);
+            claimLoop();
+            shared->active.fetch_sub(1);
+        });
+
+    claimLoop();
+
+    //every chunk is claimed, the ones still running elsewhere finish on their own
+    while (shared->active.load() > 0)
+        std::this_thread::yield();
+}
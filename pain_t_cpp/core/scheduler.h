@@ -0,0 +1,126 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//queues fn to run on the GLib main loop, safe to call from any thread
+void runOnMainLoop(std::function<void()> fn);
+
+//Value produced by a pool task. then() hands it to a continuation on the
+//GLib main loop, get() blocks for it when the caller cannot go on without it.
+template<class T>
+class Future{
+public:
+    Future() = default;
+
+    bool valid() const {return state != nullptr;}
+    bool ready() const{
+        std::lock_guard<std::mutex> lock(state->m);
+        return state->done;
+    }
+
+    const T& 
+    get() const{
+        std::unique_lock<std::mutex> lock(state->m);
+        state->cv.wait(lock, [&]{return state->done;});
+        return state->value;
+    }
+
+    void 
+    then(std::function<void(T&)> fn){
+        std::lock_guard<std::mutex> lock(state->m);
+        state->cont = std::move(fn);
+        if (state->done) post(state);
+    }
+
+private:
+    friend class Scheduler;
+
+    struct State{
+        std::mutex m;
+        std::condition_variable cv;
+        bool done = false;
+        T value{};
+        std::function<void(T&)> cont;
+    };
+
+    static void 
+    post(const std::shared_ptr<State>& s){
+        runOnMainLoop([s]{s->cont(s->value);});
+    }
+
+    static void 
+    resolve(const std::shared_ptr<State>& s, T v){
+        std::lock_guard<std::mutex> lock(s->m);
+        s->value = std::move(v);
+        s->done = true;
+        s->cv.notify_all();
+        if (s->cont) post(s);
+    }
+
+    std::shared_ptr<State> state;
+};
+
+//Fixed pool of workers, one per core minus the main thread. Each worker owns
+//a deque: it pops its own tasks from the back (newest, still in cache) and
+//steals from the front of the others' when it runs dry.
+class Scheduler{
+public:
+    static Scheduler& shared();
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    //workers plus the calling thread
+    int threads() const {return static_cast<int>(workers.size()) + 1;}
+
+    //fire and forget
+    void submit(std::function<void()> task);
+
+    template<class T>
+    Future<T> 
+    async(std::function<T()> work){
+        Future<T> f;
+        f.state = std::make_shared<typename Future<T>::State>();
+        auto s = f.state;
+        submit([s, work = std::move(work)]{Future<T>::resolve(s, work());});
+        return f;
+    }
+
+    //see parallelFor() in parallel.h
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+private:
+    using Task = std::function<void()>;
+
+    struct Worker{
+        std::mutex m;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    explicit Scheduler(int workerCount);
+
+    void run(int self);
+    bool findTask(int self, Task& out);
+    void push(int target, Task task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned> nextTarget{0};
+
+    //sleeping workers wait here until something is queued
+    std::mutex sleepM;
+    std::condition_variable sleepCv;
+    std::atomic<int> queued{0};
+    bool stopping = false;
+};
+
+#endif
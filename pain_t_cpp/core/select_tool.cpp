@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "select_tool.h"
+#include "fill.h"
+
+SelectTool::SelectTool(Selection& target, Shape shape)
+    : target(target), shape(shape){}
+
+void 
+SelectTool::setTolerance(int t){
+    tolerance = std::clamp(t, 0, 255);
+}
+
+void 
+SelectTool::press(Canvas& canvas, int x, int y){
+    if (shape == Shape::Wand){
+        //magic wand reuses the fill region search
+        ColorMatch match;
+        match.target = canvas.getPixel(x, y);
+        match.tolerance = tolerance;
+
+        std::vector<Span> region;
+        Fill::findRegion(canvas, x, y, match, region);
+        if (region.empty()) target.clear();
+        else target.selectSpans(canvas.getWidth(), canvas.getHeight(), region);
+        return;
+    }
+
+    dragging = true;
+    startX = curX = x;
+    startY = curY = y;
+    path.clear();
+    path.emplace_back(static_cast<float>(x), static_cast<float>(y));
+}
+
+void 
+SelectTool::drag(Canvas&, int x, int y){
+    if (!dragging) return;
+    curX = x;
+    curY = y;
+    if (shape == Shape::Lasso)
+        path.emplace_back(static_cast<float>(x), static_cast<float>(y));
+}
+
+void 
+SelectTool::release(Canvas& canvas, int x, int y){
+    if (!dragging) return;
+    dragging = false;
+    curX = x;
+    curY = y;
+
+    if (shape == Shape::Rectangle){
+        Rect r{std::min(startX, curX), std::min(startY, curY),
+               std::abs(curX - startX), std::abs(curY - startY)};
+        //a plain click drops the selection
+        if (r.w < 2 && r.h < 2) target.clear();
+        else target.selectRect(canvas.getWidth(), canvas.getHeight(), r);
+    } else{
+        path.emplace_back(static_cast<float>(x), static_cast<float>(y));
+        if (path.size() < 3) target.clear();
+        else target.selectPolygon(canvas.getWidth(), canvas.getHeight(), path);
+        path.clear();
+    }
+}
+
+void 
+SelectTool::drawOverlay(cairo_t* cr){
+    if (!dragging) return;
+
+    static const double dash[] = {4.0, 4.0};
+    cairo_save(cr);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_dash(cr, dash, 2, 0.0);
+    cairo_set_source_rgb(cr, 0, 0, 1);
+
+    if (shape == Shape::Rectangle){
+        cairo_rectangle(cr, std::min(startX, curX) + 0.5, std::min(startY, curY) + 0.5,
+                        std::abs(curX - startX), std::abs(curY - startY));
+    } else if (!path.empty()){
+        cairo_move_to(cr, path[0].first, path[0].second);
+        for (const auto& p : path) cairo_line_to(cr, p.first, p.second);
+        cairo_close_path(cr);
+    }
+    cairo_stroke(cr);
+    cairo_restore(cr);
+}
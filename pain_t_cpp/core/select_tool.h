@@ -0,0 +1,44 @@
+#ifndef SELECT_TOOL_H
+#define SELECT_TOOL_H
+
+#include <vector>
+#include <utility>
+
+#include "tool.h"
+#include "selection.h"
+#include "color_match.h"
+
+//Edits the document selection instead of pixels.
+class SelectTool : public Tool{
+public:
+    enum class Shape{
+        Rectangle,
+        Lasso,
+        Wand
+    };
+
+    SelectTool(Selection& target, Shape shape);
+
+    void press(Canvas& canvas, int x, int y) override;
+    void drag(Canvas& canvas, int x, int y) override;
+    void release(Canvas& canvas, int x, int y) override;
+    void drawOverlay(cairo_t* cr) override;
+
+    bool editsPixels() const override {return false;}
+
+    bool supportsTolerance() const override {return shape == Shape::Wand;}
+    void setTolerance(int t) override;
+    int getTolerance() const override {return tolerance;}
+
+private:
+    Selection& target;
+    Shape shape;
+    int tolerance = 32;
+
+    bool dragging = false;
+    int startX = 0, startY = 0;
+    int curX = 0, curY = 0;
+    std::vector<std::pair<float, float>> path;
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <cmath>
+
+#include "selection.h"
+
+void 
+Selection::clear(){
+    active = false;
+    rows.clear();
+    edges.clear();
+    box = Rect();
+    offsetX = offsetY = 0;
+}
+
+void 
+Selection::translate(int dx, int dy){
+    offsetX += dx;
+    offsetY += dy;
+}
+
+void 
+Selection::selectRect(int canvasW, int canvasH, Rect r){
+    rows.assign(canvasH, {});
+    int x0 = std::max(r.x, 0), x1 = std::min(r.x + r.w, canvasW);
+    int y0 = std::max(r.y, 0), y1 = std::min(r.y + r.h, canvasH);
+    if (x0 < x1){
+        for (int y = y0; y < y1; ++y)
+            rows[y].push_back({x0, x1});
+    }
+    finish();
+}
+
+void 
+Selection::selectPolygon(int canvasW, int canvasH, const std::vector<std::pair<float, float>>& pts){
+    rows.assign(canvasH, {});
+    size_t n = pts.size();
+    std::vector<float> xs;
+
+    //sample each row at pixel centres, pair up the crossings
+    for (int y = 0; y < canvasH && n >= 3; ++y){
+        float sy = y + 0.5f;
+        xs.clear();
+        for (size_t i = 0; i < n; ++i){
+            auto [ax, ay] = pts[i];
+            auto [bx, by] = pts[(i + 1) % n];
+            if ((ay <= sy) == (by <= sy)) continue;
+            xs.push_back(ax + (sy - ay) * (bx - ax) / (by - ay));
+        }
+        std::sort(xs.begin(), xs.end());
+
+        for (size_t i = 0; i + 1 < xs.size(); i += 2){
+            int x0 = std::max(0, static_cast<int>(std::ceil(xs[i] - 0.5f)));
+            int x1 = std::min(canvasW, static_cast<int>(std::ceil(xs[i + 1] - 0.5f)));
+            if (x0 >= x1) continue;
+            if (!rows[y].empty() && rows[y].back().x1 >= x0)
+                rows[y].back().x1 = std::max(rows[y].back().x1, x1);
+            else
+                rows[y].push_back({x0, x1});
+        }
+    }
+    finish();
+}
+
+void 
+Selection::selectSpans(int canvasW, int canvasH, const std::vector<Span>& spans){
+    rows.assign(canvasH, {});
+    for (const Span& s : spans){
+        if (s.y < 0 || s.y >= canvasH) continue;
+        int x0 = std::max(s.x0, 0), x1 = std::min(s.x1, canvasW);
+        if (x0 < x1) rows[s.y].push_back({x0, x1});
+    }
+
+    //region searches emit runs in any order, normalise and merge touching ones
+    for (auto& r : rows){
+        if (r.size() < 2) continue;
+        std::sort(r.begin(), r.end(), [](const Run& a, const Run& b){return a.x0 < b.x0;});
+        size_t out = 0;
+        for (size_t i = 1; i < r.size(); ++i){
+            if (r[i].x0 <= r[out].x1) r[out].x1 = std::max(r[out].x1, r[i].x1);
+            else r[++out] = r[i];
+        }
+        r.resize(out + 1);
+    }
+    finish();
+}
+
+bool 
+Selection::contains(int x, int y) const{
+    bool hit = false;
+    clipSpan(y, x, x + 1, [&](int, int){hit = true;});
+    return hit;
+}
+
+//parts of `a` not covered by any run of `b`, both sorted
+static void 
+subtractRuns(const std::vector<Selection::Run>& a, const std::vector<Selection::Run>* b,
+             std::vector<Selection::Run>& out){
+    out.clear();
+    size_t j = 0;
+    for (const auto& run : a){
+        int x = run.x0;
+        if (b){
+            while (j < b->size() && (*b)[j].x1 <= x) ++j;
+            for (size_t k = j; k < b->size() && (*b)[k].x0 < run.x1; ++k){
+                if ((*b)[k].x0 > x) out.push_back({x, (*b)[k].x0});
+                x = std::max(x, (*b)[k].x1);
+            }
+        }
+        if (x < run.x1) out.push_back({x, run.x1});
+    }
+}
+
+void 
+Selection::finish(){
+    active = true;
+    offsetX = offsetY = 0;
+    edges.clear();
+
+    int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+    std::vector<Run> open;
+    int h = static_cast<int>(rows.size());
+
+    for (int y = 0; y < h; ++y){
+        const auto& r = rows[y];
+        if (r.empty()) continue;
+        minX = std::min(minX, r.front().x0);
+        maxX = std::max(maxX, r.back().x1);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y + 1);
+
+        for (const Run& run : r){
+            edges.push_back({run.x0, y, run.x0, y + 1});
+            edges.push_back({run.x1, y, run.x1, y + 1});
+        }
+
+        //top and bottom borders are the parts not shared with the neighbour row
+        subtractRuns(r, y > 0 ? &rows[y - 1] : nullptr, open);
+        for (const Run& e : open) edges.push_back({e.x0, y, e.x1, y});
+        subtractRuns(r, y + 1 < h ? &rows[y + 1] : nullptr, open);
+        for (const Run& e : open) edges.push_back({e.x0, y + 1, e.x1, y + 1});
+    }
+
+    box = (minX <= maxX) ? Rect{minX, minY, maxX - minX, maxY - minY} : Rect();
+}
+
+void 
+Selection::drawOutline(cairo_t* cr) const{
+    if (!active || edges.empty()) return;
+
+    static const double dash[] = {4.0, 4.0};
+    cairo_save(cr);
+    cairo_translate(cr, offsetX, offsetY);
+    cairo_set_line_width(cr, 1.0);
+    for (int pass = 0; pass < 2; ++pass){
+        if (pass == 0) cairo_set_source_rgb(cr, 0, 0, 0);
+        else cairo_set_source_rgb(cr, 1, 1, 1);
+        cairo_set_dash(cr, dash, 2, pass * 4.0);
+
+        for (const Edge& e : edges){
+            cairo_move_to(cr, e.x0 + 0.5, e.y0 + 0.5);
+            cairo_line_to(cr, e.x1 + 0.5, e.y1 + 0.5);
+        }
+        cairo_stroke(cr);
+    }
+    cairo_restore(cr);
+}
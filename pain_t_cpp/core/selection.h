@@ -0,0 +1,79 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cairo.h>
+
+#include "canvas.h"
+
+//Pixel mask stored as sorted, non-overlapping runs per row. An inactive
+//selection means "everything", so tools only pay for clipping when a
+//selection exists, and then once per span instead of once per pixel.
+class Selection{
+public:
+    struct Run{
+        int x0, x1;
+    };
+
+    Selection() = default;
+
+    bool isActive() const {return active;}
+    void clear();
+
+    void selectRect(int canvasW, int canvasH, Rect r);
+    //lasso, even-odd rule, points in canvas coordinates
+    void selectPolygon(int canvasW, int canvasH, const std::vector<std::pair<float, float>>& pts);
+    //magic wand result or any other span list
+    void selectSpans(int canvasW, int canvasH, const std::vector<Span>& spans);
+
+    //shifts the mask by (dx, dy); parts pushed off the canvas are kept and
+    //come back when it is shifted back
+    void translate(int dx, int dy);
+
+    bool contains(int x, int y) const;
+    Rect bounds() const {return box.w > 0 ? Rect{box.x + offsetX, box.y + offsetY, box.w, box.h} : box;}
+
+    //calls fn(a, b) for every selected piece [a, b) of [x0, x1) on row y
+    template<class F>
+    void 
+    clipSpan(int y, int x0, int x1, F&& fn) const{
+        if (!active){
+            if (x0 < x1) fn(x0, x1);
+            return;
+        }
+        y -= offsetY;
+        if (y < 0 || y >= static_cast<int>(rows.size())) return;
+
+        //runs are stored unshifted
+        x0 -= offsetX;
+        x1 -= offsetX;
+        const std::vector<Run>& r = rows[y];
+        auto it = std::upper_bound(r.begin(), r.end(), x0,
+                                   [](int v, const Run& run){return v < run.x1;});
+        for (; it != r.end() && it->x0 < x1; ++it){
+            int a = std::max(x0, it->x0);
+            int b = std::min(x1, it->x1);
+            if (a < b) fn(a + offsetX, b + offsetX);
+        }
+    }
+
+    //marching-ants style outline along the pixel edges of the mask
+    void drawOutline(cairo_t* cr) const;
+
+private:
+    void finish();
+
+    bool active = false;
+    std::vector<std::vector<Run>> rows;
+    Rect box;
+    int offsetX = 0, offsetY = 0;
+
+    struct Edge{
+        int x0, y0, x1, y1;
+    };
+    std::vector<Edge> edges;
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "shape_tool.h"
+
+ShapeTool::ShapeTool(uint32_t color, Shape shape, int size)
+    : color(color), shape(shape), size(size)
+{
+    setSize(size);
+}
+
+void 
+ShapeTool::setSize(int s){
+    size = std::clamp(s, 1, 100);
+}
+
+void 
+ShapeTool::press(Canvas& canvas, int x, int y){
+    if (shape != Shape::Polygon){
+        path = {{x, y}, {x, y}};
+        return;
+    }
+
+    if (path.size() >= 3 && std::abs(x - path[0].first) <= CLOSE_DISTANCE
+                         && std::abs(y - path[0].second) <= CLOSE_DISTANCE){
+        commit(canvas);
+        return;
+    }
+    path.emplace_back(x, y);
+}
+
+void 
+ShapeTool::drag(Canvas&, int x, int y){
+    if (path.empty()) return;
+    path.back() = {x, y};
+}
+
+void 
+ShapeTool::release(Canvas& canvas, int x, int y){
+    if (path.empty()) return;
+    path.back() = {x, y};
+    //polygons stay open for the next vertex
+    if (shape != Shape::Polygon) commit(canvas);
+}
+
+void 
+ShapeTool::apply(Canvas& canvas){
+    commit(canvas);
+}
+
+void 
+ShapeTool::build(Rasterizer& r) const{
+    //integer positions address pixel centres, the stroke is centred on them
+    float hw = size * 0.5f;
+    auto at = [&](size_t i){
+        return std::make_pair(path[i].first + 0.5f, path[i].second + 0.5f);
+    };
+
+    switch (shape){
+        case Shape::Line:{
+            auto [x0, y0] = at(0);
+            auto [x1, y1] = at(1);
+            r.addCapsule(x0, y0, x1, y1, hw);
+            break;
+        }
+        case Shape::Rectangle:{
+            auto [ax, ay] = at(0);
+            auto [bx, by] = at(1);
+            float x0 = std::min(ax, bx), x1 = std::max(ax, bx);
+            float y0 = std::min(ay, by), y1 = std::max(ay, by);
+            r.addContour({{x0 - hw, y0 - hw}, {x1 + hw, y0 - hw}, {x1 + hw, y1 + hw}, {x0 - hw, y1 + hw}});
+            //inner edge wound the other way, non-zero leaves it empty
+            if (x1 - x0 > 2 * hw && y1 - y0 > 2 * hw)
+                r.addContour({{x0 + hw, y0 + hw}, {x0 + hw, y1 - hw}, {x1 - hw, y1 - hw}, {x1 - hw, y0 + hw}});
+            break;
+        }
+        case Shape::Ellipse:{
+            auto [ax, ay] = at(0);
+            auto [bx, by] = at(1);
+            float cx = (ax + bx) * 0.5f, cy = (ay + by) * 0.5f;
+            float rx = std::abs(bx - ax) * 0.5f, ry = std::abs(by - ay) * 0.5f;
+            r.addEllipse(cx, cy, rx + hw, ry + hw);
+            if (rx > hw && ry > hw) r.addEllipse(cx, cy, rx - hw, ry - hw, true);
+            break;
+        }
+        case Shape::Polygon:{
+            //one capsule per edge, closing edge included; they all wind
+            //the same way so the joins merge
+            size_t n = path.size();
+            for (size_t i = 0; i < n; ++i){
+                if (n == 2 && i == 1) break;
+                auto [x0, y0] = at(i);
+                auto [x1, y1] = at((i + 1) % n);
+                r.addCapsule(x0, y0, x1, y1, hw);
+            }
+            break;
+        }
+    }
+}
+
+void 
+ShapeTool::commit(Canvas& c){
+    if (path.empty()) return;
+    if (path.size() < 2) path.push_back(path[0]);
+
+    Rasterizer r(antialias);
+    build(r);
+    path.clear();
+
+    SolidSpanFn solid = solidSpanKernel(mode, false);
+    SolidSpanFn masked = solidSpanKernel(mode, true);
+    uint32_t src = premultiply(color);
+    uint32_t* pixels = c.getPixels().data();
+    int w = c.getWidth();
+
+    r.render(w, c.getHeight(), [&](int y, int x0, int x1, const uint8_t* cov){
+        uint32_t* row = pixels + static_cast<size_t>(y) * w;
+        forSelected(y, x0, x1, [&](int a, int b){
+            if (cov) masked(row + a, cov + (a - x0), b - a, src);
+            else solid(row + a, nullptr, b - a, src);
+        });
+    });
+    Rect b = r.bounds();
+    c.markDirty(b.x, b.y, b.w, b.h);
+}
+
+void 
+ShapeTool::drawOverlay(cairo_t* cr){
+    if (path.empty()) return;
+
+    uint32_t p = premultiply(color);
+    double a = (p >> 24) / 255.0;
+    cairo_save(cr);
+    if (a > 0.0)
+        cairo_set_source_rgba(cr, ((p >> 16) & 0xFF) / 255.0 / a, ((p >> 8) & 0xFF) / 255.0 / a, (p & 0xFF) / 255.0 / a, a);
+    cairo_set_line_width(cr, size);
+    cairo_set_line_cap(cr, CAIRO_LINE_CAP_ROUND);
+    cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+    cairo_set_antialias(cr, antialias ? CAIRO_ANTIALIAS_DEFAULT : CAIRO_ANTIALIAS_NONE);
+
+    double x0 = path[0].first + 0.5, y0 = path[0].second + 0.5;
+    double x1 = path.back().first + 0.5, y1 = path.back().second + 0.5;
+    switch (shape){
+        case Shape::Line:
+            cairo_move_to(cr, x0, y0);
+            cairo_line_to(cr, x1, y1);
+            break;
+        case Shape::Rectangle:
+            cairo_set_line_join(cr, CAIRO_LINE_JOIN_MITER);
+            cairo_rectangle(cr, std::min(x0, x1), std::min(y0, y1), std::abs(x1 - x0), std::abs(y1 - y0));
+            break;
+        case Shape::Ellipse:{
+            double rx = std::abs(x1 - x0) / 2, ry = std::abs(y1 - y0) / 2;
+            if (rx > 0 && ry > 0){
+                cairo_save(cr);
+                cairo_translate(cr, (x0 + x1) / 2, (y0 + y1) / 2);
+                cairo_scale(cr, rx, ry);
+                cairo_arc(cr, 0, 0, 1, 0, 2 * M_PI);
+                cairo_restore(cr);
+            }
+            break;
+        }
+        case Shape::Polygon:
+            cairo_move_to(cr, x0, y0);
+            for (const auto& v : path) cairo_line_to(cr, v.first + 0.5, v.second + 0.5);
+            //the edge commit adds back to the first vertex
+            if (path.size() > 2) cairo_close_path(cr);
+            break;
+    }
+    cairo_stroke(cr);
+    cairo_restore(cr);
+}
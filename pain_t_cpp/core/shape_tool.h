@@ -0,0 +1,71 @@
+#ifndef SHAPE_TOOL_H
+#define SHAPE_TOOL_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "tool.h"
+#include "raster.h"
+
+//Line, rectangle, ellipse and polygon outlines. While the shape is being
+//placed it only exists as a cairo overlay; the canvas is written once, on
+//commit, through the scanline rasterizer.
+class ShapeTool : public Tool{
+public:
+    enum class Shape{
+        Line,
+        Rectangle,
+        Ellipse,
+        Polygon     //click per vertex, click the first one again or press Return to close
+    };
+
+    ShapeTool(uint32_t color, Shape shape, int size = 2);
+
+    void press(Canvas& canvas, int x, int y) override;
+    void drag(Canvas& canvas, int x, int y) override;
+    void release(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> clone() const override{return std::make_unique<ShapeTool>(*this);}
+    void drawOverlay(cairo_t* cr) override;
+    void apply(Canvas& canvas) override;
+
+    //extra polygon vertices extend the edit the first click started
+    bool beginsEdit() const override {return path.empty();}
+
+    bool usesColor() const override {return true;}
+    void setColor(uint32_t c) override {color = c;}
+    uint32_t getColor() const override {return color;}
+
+    bool supportsSize() const override {return true;}
+    void setSize(int s) override;
+    int getSize() const override {return size;}
+
+    bool supportsBlendMode() const override {return true;}
+    void setBlendMode(BlendMode m) override {mode = m;}
+    BlendMode getBlendMode() const override {return mode;}
+
+    bool supportsSoftness() const override {return true;}
+    bool supportsHardness() const override {return false;}
+    void setAntialias(bool on) override {antialias = on;}
+    bool getAntialias() const override {return antialias;}
+
+private:
+    //outline of the current path as contours
+    void build(Rasterizer& r) const;
+    void commit(Canvas& canvas);
+
+    //a polygon click this close to the first vertex closes it
+    static constexpr int CLOSE_DISTANCE = 6;
+
+    uint32_t color;
+    Shape shape;
+    int size;
+    BlendMode mode = BlendMode::Normal;
+    bool antialias = true;
+
+    //two corners for line/rectangle/ellipse, every vertex for a polygon;
+    //the last point follows the pointer while the button is held
+    std::vector<std::pair<int, int>> path;
+};
+
+#endif
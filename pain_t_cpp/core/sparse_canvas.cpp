@@ -0,0 +1,155 @@
+#include <algorithm>
+
+#include "sparse_canvas.h"
+#include "blend.h"
+
+SparseCanvas::SparseCanvas(uint32_t background, MemCategory cat) : background(background), category(cat){}
+
+const SparseCanvas::Tile* 
+SparseCanvas::find(int tx, int ty) const{
+    auto it = tiles.find(key(tx, ty));
+    return it == tiles.end() ? nullptr : it->second.get();
+}
+
+SparseCanvas::Tile& 
+SparseCanvas::touch(int tx, int ty){
+    std::unique_ptr<Tile>& t = tiles[key(tx, ty)];
+    if (!t){
+        t = std::make_unique<Tile>();
+        t->pixels.assign(TILE * TILE, background);
+        t->charge = MemoryCharge(category, static_cast<int64_t>(TILE * TILE * sizeof(uint32_t)));
+    }
+    return *t;
+}
+
+uint32_t 
+SparseCanvas::getPixel(int x, int y) const{
+    int tx = tileOf(x), ty = tileOf(y);
+    const Tile* t = find(tx, ty);
+    if (!t) return background;
+    return t->pixels[(y - ty * TILE) * TILE + (x - tx * TILE)];
+}
+
+void 
+SparseCanvas::setPixel(int x, int y, uint32_t color){
+    int tx = tileOf(x), ty = tileOf(y);
+    if (color == background && !find(tx, ty)) return;
+    touch(tx, ty).pixels[(y - ty * TILE) * TILE + (x - tx * TILE)] = color;
+}
+
+void 
+SparseCanvas::read(int x, int y, Canvas& dst) const{
+    read(x, y, dst, {0, 0, dst.getWidth(), dst.getHeight()});
+}
+
+void 
+SparseCanvas::read(int x, int y, Canvas& dst, const Rect& part) const{
+    if (part.empty()) return;
+    int w = dst.getWidth();
+    uint32_t* out = dst.getPixels().data();
+    int bx = x + part.x, by = y + part.y;
+
+    //tile by tile, holes are filled without touching the map again
+    for (int ty = tileOf(by); ty <= tileOf(by + part.h - 1); ++ty){
+        int y0 = std::max(by, ty * TILE), y1 = std::min(by + part.h, (ty + 1) * TILE);
+        for (int tx = tileOf(bx); tx <= tileOf(bx + part.w - 1); ++tx){
+            int x0 = std::max(bx, tx * TILE), x1 = std::min(bx + part.w, (tx + 1) * TILE);
+            const Tile* t = find(tx, ty);
+            for (int py = y0; py < y1; ++py){
+                uint32_t* row = out + static_cast<size_t>(py - y) * w + (x0 - x);
+                if (t) std::copy_n(t->pixels.data() + (py - ty * TILE) * TILE + (x0 - tx * TILE), x1 - x0, row);
+                else std::fill(row, row + (x1 - x0), background);
+            }
+        }
+    }
+    dst.markDirty(part.x, part.y, part.w, part.h);
+}
+
+void 
+SparseCanvas::write(int x, int y, const Canvas& src){
+    write(x, y, src, {0, 0, src.getWidth(), src.getHeight()});
+}
+
+void 
+SparseCanvas::write(int x, int y, const Canvas& src, const Rect& part){
+    if (part.empty()) return;
+    int w = src.getWidth();
+    const uint32_t* in = src.getPixels().data();
+    int bx = x + part.x, by = y + part.y;
+
+    for (int ty = tileOf(by); ty <= tileOf(by + part.h - 1); ++ty){
+        int y0 = std::max(by, ty * TILE), y1 = std::min(by + part.h, (ty + 1) * TILE);
+        for (int tx = tileOf(bx); tx <= tileOf(bx + part.w - 1); ++tx){
+            int x0 = std::max(bx, tx * TILE), x1 = std::min(bx + part.w, (tx + 1) * TILE);
+            auto row = [&](int py){return in + static_cast<size_t>(py - y) * w + (x0 - x);};
+            auto blank = [&](int py){
+                const uint32_t* r = row(py);
+                return std::all_of(r, r + (x1 - x0), [&](uint32_t p){return p == background;});
+            };
+
+            auto it = tiles.find(key(tx, ty));
+            if (it == tiles.end()){
+                //nothing stored and nothing painted here, stays implicit
+                bool empty = true;
+                for (int py = y0; py < y1 && empty; ++py) empty = blank(py);
+                if (empty) continue;
+            }
+            Tile& t = touch(tx, ty);
+            for (int py = y0; py < y1; ++py)
+                std::copy_n(row(py), x1 - x0, t.pixels.data() + (py - ty * TILE) * TILE + (x0 - tx * TILE));
+
+            //painted back to the background, free it
+            if (std::all_of(t.pixels.begin(), t.pixels.end(), [&](uint32_t p){return p == background;}))
+                tiles.erase(key(tx, ty));
+        }
+    }
+}
+
+void 
+SparseCanvas::blendOnto(int x, int y, int w, int h, uint32_t* dst, size_t stride, uint8_t opacity) const{
+    bool clear = (background >> 24) == 0;
+    std::vector<uint32_t> hole;
+    if (!clear) hole.assign(TILE, background);
+
+    for (int ty = tileOf(y); ty <= tileOf(y + h - 1); ++ty){
+        int y0 = std::max(y, ty * TILE), y1 = std::min(y + h, (ty + 1) * TILE);
+        for (int tx = tileOf(x); tx <= tileOf(x + w - 1); ++tx){
+            int x0 = std::max(x, tx * TILE), x1 = std::min(x + w, (tx + 1) * TILE);
+            const Tile* t = find(tx, ty);
+            if (!t && clear) continue;
+            for (int py = y0; py < y1; ++py){
+                uint32_t* row = dst + static_cast<size_t>(py - y) * stride + (x0 - x);
+                const uint32_t* src = t ? t->pixels.data() + (py - ty * TILE) * TILE + (x0 - tx * TILE) : hole.data();
+                blendOverSpan(row, src, x1 - x0, opacity);
+            }
+        }
+    }
+}
+
+Rect 
+SparseCanvas::bounds() const{
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+    bool any = false;
+    for (const auto& [k, t] : tiles){
+        int tx = static_cast<int32_t>(static_cast<uint32_t>(k));
+        int ty = static_cast<int32_t>(static_cast<uint32_t>(k >> 32));
+        for (int py = 0; py < TILE; ++py){
+            const uint32_t* row = t->pixels.data() + py * TILE;
+            for (int px = 0; px < TILE; ++px){
+                if (row[px] == background) continue;
+                int gx = tx * TILE + px, gy = ty * TILE + py;
+                if (!any){
+                    x0 = x1 = gx;
+                    y0 = y1 = gy;
+                    any = true;
+                }
+                x0 = std::min(x0, gx);
+                x1 = std::max(x1, gx);
+                y0 = std::min(y0, gy);
+                y1 = std::max(y1, gy);
+            }
+        }
+    }
+    if (!any) return {};
+    return {x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+}
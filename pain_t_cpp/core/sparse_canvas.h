@@ -0,0 +1,62 @@
+#ifndef SPARSE_CANVAS_H
+#define SPARSE_CANVAS_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "canvas.h"
+#include "memory.h"
+
+//Unbounded image stored as tiles, only where it differs from one constant
+//background value. Coordinates may be negative. Reading an unpainted area
+//allocates nothing, and tiles that go back to the background are freed.
+class SparseCanvas{
+public:
+    explicit SparseCanvas(uint32_t background, MemCategory cat = MemCategory::Layers);
+
+    uint32_t getBackground() const {return background;}
+    uint32_t getPixel(int x, int y) const;
+    void setPixel(int x, int y, uint32_t color);
+
+    //copies the area at (x, y) the size of `dst` into it
+    void read(int x, int y, Canvas& dst) const;
+    //same, only the part of `dst` inside `part`
+    void read(int x, int y, Canvas& dst, const Rect& part) const;
+    //stores all of `src` at (x, y)
+    void write(int x, int y, const Canvas& src);
+    //same, only the part of `src` inside `part`
+    void write(int x, int y, const Canvas& src, const Rect& part);
+    //blends the w x h area at (x, y) over dst, whose rows are stride pixels
+    //apart; unpainted tiles of a transparent canvas are skipped
+    void blendOnto(int x, int y, int w, int h, uint32_t* dst, size_t stride, uint8_t opacity) const;
+
+    //smallest rectangle holding every pixel that is not the background
+    Rect bounds() const;
+    size_t tileCount() const {return tiles.size();}
+
+private:
+    static constexpr int TILE = 64;
+
+    struct Tile{
+        std::vector<uint32_t> pixels;
+        MemoryCharge charge;
+    };
+
+    static uint64_t 
+    key(int tx, int ty){
+        return (static_cast<uint64_t>(static_cast<uint32_t>(ty)) << 32) | static_cast<uint32_t>(tx);
+    }
+    //floor division, tiles left of or above the origin have negative indices
+    static int tileOf(int v){return v >= 0 ? v / TILE : -((-v + TILE - 1) / TILE);}
+
+    const Tile* find(int tx, int ty) const;
+    Tile& touch(int tx, int ty);
+
+    uint32_t background;
+    MemCategory category;
+    std::unordered_map<uint64_t, std::unique_ptr<Tile>> tiles;
+};
+
+#endif
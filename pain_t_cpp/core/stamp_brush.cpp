@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <cmath>
+
+#include "stamp_brush.h"
+#include "blend.h"
+
+StampBrush::StampBrush(uint32_t color, std::shared_ptr<StampCache> tip, int size)
+    : color(color), tip(std::move(tip)), size(size)
+{
+    setSize(size);
+}
+
+void 
+StampBrush::setSize(int s){
+    size = std::clamp(s, 1, 100);
+}
+
+void 
+StampBrush::press(Canvas& c, int x, int y){
+    stroking = true;
+    carry = 0.0f;
+    //every stroke starts upright, not along the last one
+    angle = 0.0f;
+    tip->prepare(size);
+    lastX = static_cast<float>(x);
+    lastY = static_cast<float>(y);
+    stamp(c, lastX, lastY);
+}
+
+void 
+StampBrush::drag(Canvas& c, int x, int y){
+    if (!stroking) return;
+    float dx = x - lastX, dy = y - lastY;
+    float len = std::sqrt(dx*dx + dy*dy);
+    if (len <= 0.0f) return;
+    angle = std::atan2(dy, dx);
+
+    //tips are usually sparse, space them further apart than round dabs
+    float spacing = std::max(1.0f, size * 0.5f);
+    float t = spacing - carry;
+    while (t <= len){
+        stamp(c, lastX + dx * t / len, lastY + dy * t / len);
+        t += spacing;
+    }
+    carry = len - (t - spacing);
+    lastX = static_cast<float>(x);
+    lastY = static_cast<float>(y);
+}
+
+void 
+StampBrush::release(Canvas&, int, int){
+    stroking = false;
+}
+
+void 
+StampBrush::stamp(Canvas& c, float cx, float cy){
+    const DabMask& m = tip->get(size, angle);
+    int ox = static_cast<int>(std::lround(cx)) - m.origin;
+    int oy = static_cast<int>(std::lround(cy)) - m.origin;
+    int x0 = std::max(0, ox), x1 = std::min(c.getWidth(),  ox + m.size);
+    int y0 = std::max(0, oy), y1 = std::min(c.getHeight(), oy + m.size);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    SolidSpanFn span = solidSpanKernel(mode, true);
+    uint32_t src = premultiply(color);
+    uint32_t* pixels = c.getPixels().data();
+    for (int y = y0; y < y1; ++y){
+        uint32_t* row = pixels + static_cast<size_t>(y) * c.getWidth();
+        const uint8_t* cov = m.coverage.data() + static_cast<size_t>(y - oy) * m.size;
+        forSelected(y, x0, x1, [&](int a, int b){
+            span(row + a, cov + (a - ox), b - a, src);
+        });
+    }
+    c.markDirty(x0, y0, x1 - x0, y1 - y0);
+}
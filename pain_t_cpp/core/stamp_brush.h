@@ -0,0 +1,47 @@
+#ifndef STAMP_BRUSH_H
+#define STAMP_BRUSH_H
+
+#include <cstdint>
+#include <memory>
+
+#include "tool.h"
+#include "stamp_cache.h"
+
+//Paints the brush colour through an image tip, turned to follow the
+//stroke. The tip is shared so switching back to the tool keeps its cache.
+class StampBrush : public Tool{
+public:
+    StampBrush(uint32_t color, std::shared_ptr<StampCache> tip, int size = 16);
+
+    void press(Canvas& canvas, int x, int y) override;
+    void drag(Canvas& canvas, int x, int y) override;
+    void release(Canvas& canvas, int x, int y) override;
+    std::unique_ptr<Tool> clone() const override{return std::make_unique<StampBrush>(*this);}
+
+    bool usesColor() const override{return true;}
+    void setColor(uint32_t c) override{color = c;}
+    uint32_t getColor() const override{return color;}
+
+    bool supportsSize() const override{return true;}
+    void setSize(int s) override;
+    int getSize() const override{return size;}
+
+    bool supportsBlendMode() const override{return true;}
+    void setBlendMode(BlendMode m) override{mode = m;}
+    BlendMode getBlendMode() const override{return mode;}
+
+private:
+    void stamp(Canvas& c, float cx, float cy);
+
+    uint32_t color;
+    std::shared_ptr<StampCache> tip;
+    int size;
+    BlendMode mode = BlendMode::Normal;
+
+    float lastX = 0, lastY = 0;
+    float angle = 0.0f;     //direction of the stroke so far
+    float carry = 0.0f;
+    bool stroking = false;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cmath>
+
+#include "stamp_cache.h"
+#include "resample.h"
+#include "parallel.h"
+
+StampCache::StampCache(const std::vector<uint32_t>& pixels, int w, int h)
+    : tip(pixels.size()), tipW(w), tipH(h)
+{
+    bool transparent = std::any_of(pixels.begin(), pixels.end(), [](uint32_t p){return (p >> 24) != 255;});
+    for (size_t i = 0; i < pixels.size(); ++i){
+        uint32_t p = pixels[i];
+        uint32_t c;
+        if (transparent){
+            c = p >> 24;
+        } else{
+            //rec. 601 luma, dark means paint
+            uint32_t luma = (((p >> 16) & 0xFF) * 77 + ((p >> 8) & 0xFF) * 150 + (p & 0xFF) * 29) >> 8;
+            c = 255 - luma;
+        }
+        tip[i] = c * 0x01010101u;
+    }
+    charge.resize(static_cast<int64_t>(tip.size() * sizeof(uint32_t)));
+}
+
+//small sizes stay exact, above that each step is ~10% bigger than the last:
+//35 steps over the brush's 1..100, every rotation of all of them fits the budget
+int 
+StampCache::step(int radius){
+    radius = std::max(1, radius);
+    int prev = 1, r = 1;
+    while (r < radius){
+        prev = r;
+        r = std::max(r + 1, static_cast<int>(std::lround(r * 1.1f)));
+    }
+    return r - radius <= radius - prev ? r : prev;
+}
+
+const DabMask& 
+StampCache::get(int radius, float angle){
+    const float turn = 6.2831853f / ANGLES;
+    int a = static_cast<int>(std::lround(angle / turn)) % ANGLES;
+    if (a < 0) a += ANGLES;
+    int r = step(radius);
+
+    auto it = masks.find(key(r, a));
+    if (it != masks.end()) return *it->second;
+    return insert(key(r, a), build(r, a));
+}
+
+void 
+StampCache::prepare(int radius){
+    int r = step(radius);
+    std::vector<int> missing;
+    for (int a = 0; a < ANGLES; ++a)
+        if (!masks.count(key(r, a))) missing.push_back(a);
+    if (missing.empty()) return;
+
+    std::vector<DabMask> built(missing.size());
+    parallelFor(0, static_cast<int>(missing.size()), 1, [&](int i0, int i1){
+        for (int i = i0; i < i1; ++i) built[i] = build(r, missing[i]);
+    });
+    for (size_t i = 0; i < missing.size(); ++i)
+        insert(key(r, missing[i]), std::move(built[i]));
+}
+
+const DabMask& 
+StampCache::insert(uint32_t k, DabMask mask){
+    //same policy as the round dabs: drop everything once over budget
+    if (bytes > BUDGET){
+        masks.clear();
+        bytes = 0;
+    }
+
+    bytes += mask.coverage.size();
+    charge.resize(static_cast<int64_t>(bytes + tip.size() * sizeof(uint32_t)));
+    return *masks.emplace(k, std::make_unique<DabMask>(std::move(mask))).first->second;
+}
+
+DabMask 
+StampCache::build(int radius, int angleStep) const{
+    //scale first with the good filter, the rotation then only has to
+    //interpolate between neighbours of the right size
+    int longest = 2 * radius + 1;
+    float scale = static_cast<float>(longest) / std::max(tipW, tipH);
+    int sw = std::max(1, static_cast<int>(std::lround(tipW * scale)));
+    int sh = std::max(1, static_cast<int>(std::lround(tipH * scale)));
+    std::vector<uint32_t> scaled(static_cast<size_t>(sw) * sh);
+    Resampler::resize(tip.data(), tipW, tipH, tipW, scaled.data(), sw, sh, sw, ResampleFilter::Lanczos3);
+
+    DabMask m;
+    m.size = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(sw * sw + sh * sh)))) | 1;
+    m.origin = m.size / 2;
+    m.coverage.assign(static_cast<size_t>(m.size) * m.size, 0);
+
+    float a = angleStep * 6.2831853f / ANGLES;
+    float ca = std::cos(a), sa = std::sin(a);
+    float half = m.size * 0.5f;
+    auto at = [&](int x, int y) -> float{
+        if (x < 0 || y < 0 || x >= sw || y >= sh) return 0.0f;
+        return static_cast<float>(scaled[static_cast<size_t>(y) * sw + x] >> 24);
+    };
+
+    for (int y = 0; y < m.size; ++y){
+        for (int x = 0; x < m.size; ++x){
+            //inverse rotation back into the scaled tip, bilinear there
+            float dx = x + 0.5f - half, dy = y + 0.5f - half;
+            float u = dx * ca + dy * sa + sw * 0.5f - 0.5f;
+            float v = -dx * sa + dy * ca + sh * 0.5f - 0.5f;
+            int u0 = static_cast<int>(std::floor(u)), v0 = static_cast<int>(std::floor(v));
+            float fu = u - u0, fv = v - v0;
+            float top = at(u0, v0) * (1 - fu) + at(u0 + 1, v0) * fu;
+            float bottom = at(u0, v0 + 1) * (1 - fu) + at(u0 + 1, v0 + 1) * fu;
+            float c = top * (1 - fv) + bottom * fv;
+            m.coverage[static_cast<size_t>(y) * m.size + x] = static_cast<uint8_t>(std::clamp(c + 0.5f, 0.0f, 255.0f));
+        }
+    }
+    return m;
+}
@@ -0,0 +1,53 @@
+#ifndef STAMP_CACHE_H
+#define STAMP_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "dab_cache.h"
+#include "memory.h"
+
+//Brush tip made from an image. Stamps only carry coverage, the brush
+//colour is applied when they are blitted. Each (size, angle) is resampled
+//and rotated once and then reused by every dab, so stamping is a plain
+//masked span blit like the round brush.
+class StampCache{
+public:
+    static constexpr int ANGLES = 16;      //rotations are quantized to 22.5 degrees
+
+    //premultiplied ARGB32; with transparency the alpha is the tip, an opaque
+    //image uses its darkness (black paints, white does not)
+    StampCache(const std::vector<uint32_t>& pixels, int w, int h);
+
+    //tip scaled so its longer side spans about 2 * radius + 1 pixels, rotated
+    //by angle (radians, clockwise on screen). Radii are rounded to steps
+    //roughly 10% apart, so a whole range of sizes shares one set of masks.
+    const DabMask& get(int radius, float angle);
+
+    //builds every rotation of radius's step up front, in parallel, so a
+    //stroke doesn't stall each time it turns
+    void prepare(int radius);
+
+    size_t byteSize() const {return bytes;}
+
+private:
+    static int step(int radius);
+    static uint32_t key(int radius, int angleStep){return (static_cast<uint32_t>(radius) << 8) | static_cast<uint32_t>(angleStep);}
+
+    DabMask build(int radius, int angleStep) const;
+    const DabMask& insert(uint32_t key, DabMask mask);
+
+    //coverage as premultiplied grey, ready for the resampler
+    std::vector<uint32_t> tip;
+    int tipW = 0, tipH = 0;
+
+    std::unordered_map<uint32_t, std::unique_ptr<DabMask>> masks;
+    size_t bytes = 0;
+    MemoryCharge charge{MemCategory::Caches, 0};
+
+    static constexpr size_t BUDGET = 16u << 20;
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <cmath>
+
+#include "symmetry.h"
+
+int 
+Symmetry::count() const{
+    switch (mode){
+        case Mode::Off:      return 1;
+        case Mode::MirrorX:
+        case Mode::MirrorY:  return 2;
+        case Mode::MirrorXY: return 4;
+        case Mode::Radial:   return std::clamp(folds, 1, MAX_COPIES);
+    }
+    return 1;
+}
+
+int 
+Symmetry::apply(float x, float y, int canvasW, int canvasH, float* xs, float* ys) const{
+    //pixel positions address centres, mirror them in continuous coordinates
+    float px = x + 0.5f, py = y + 0.5f;
+    float cx = canvasW * 0.5f, cy = canvasH * 0.5f;
+    int n = count();
+
+    if (mode == Mode::Radial){
+        float dx = px - cx, dy = py - cy;
+        for (int k = 0; k < n; ++k){
+            float a = 6.2831853f * k / n;
+            float ca = std::cos(a), sa = std::sin(a);
+            xs[k] = cx + dx * ca - dy * sa - 0.5f;
+            ys[k] = cy + dx * sa + dy * ca - 0.5f;
+        }
+        return n;
+    }
+
+    xs[0] = x;
+    ys[0] = y;
+    float mx = 2.0f * cx - px - 0.5f, my = 2.0f * cy - py - 0.5f;
+    if (mode == Mode::MirrorX){
+        xs[1] = mx; ys[1] = y;
+    } else if (mode == Mode::MirrorY){
+        xs[1] = x; ys[1] = my;
+    } else if (mode == Mode::MirrorXY){
+        xs[1] = mx; ys[1] = y;
+        xs[2] = x;  ys[2] = my;
+        xs[3] = mx; ys[3] = my;
+    }
+    return n;
+}
+
+void 
+Symmetry::drawGuides(cairo_t* cr, int canvasW, int canvasH) const{
+    if (mode == Mode::Off) return;
+
+    static const double dash[] = {6.0, 6.0};
+    double cx = canvasW * 0.5, cy = canvasH * 0.5;
+    cairo_save(cr);
+    cairo_set_line_width(cr, 1.0);
+    cairo_set_dash(cr, dash, 2, 0.0);
+    cairo_set_source_rgba(cr, 0.2, 0.4, 1.0, 0.6);
+
+    if (mode == Mode::MirrorX || mode == Mode::MirrorXY){
+        cairo_move_to(cr, cx, 0);
+        cairo_line_to(cr, cx, canvasH);
+    }
+    if (mode == Mode::MirrorY || mode == Mode::MirrorXY){
+        cairo_move_to(cr, 0, cy);
+        cairo_line_to(cr, canvasW, cy);
+    }
+    if (mode == Mode::Radial){
+        double len = std::hypot(cx, cy);
+        int n = count();
+        for (int k = 0; k < n; ++k){
+            double a = 2 * M_PI * k / n - M_PI / 2;
+            cairo_move_to(cr, cx, cy);
+            cairo_line_to(cr, cx + len * std::cos(a), cy + len * std::sin(a));
+        }
+    }
+    cairo_stroke(cr);
+    cairo_restore(cr);
+}
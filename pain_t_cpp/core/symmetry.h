@@ -0,0 +1,31 @@
+#ifndef SYMMETRY_H
+#define SYMMETRY_H
+
+#include <cairo.h>
+
+//Mirror and rotational copies of painting input around the canvas centre.
+struct Symmetry{
+    enum class Mode{
+        Off,
+        MirrorX,    //left/right across the vertical centre line
+        MirrorY,    //top/bottom across the horizontal centre line
+        MirrorXY,   //both, four copies
+        Radial      //folds copies rotated around the centre
+    };
+
+    static constexpr int MAX_COPIES = 16;
+
+    Mode mode = Mode::Off;
+    int folds = 6;
+
+    //copies per input point, the original included
+    int count() const;
+
+    //images of pixel position (x, y), the original first; returns count()
+    int apply(float x, float y, int canvasW, int canvasH, float* xs, float* ys) const;
+
+    //axes or spokes for the overlay
+    void drawGuides(cairo_t* cr, int canvasW, int canvasH) const;
+};
+
+#endif
@@ -2,9 +2,13 @@
 #define TOOL_H
 
 #include <cstdint>
+#include <memory>
 #include <cairo.h>
 
 #include "canvas.h"
+#include "blend.h"
+#include "selection.h"
+#include "symmetry.h"
 
 class Tool{
 public:
@@ -19,10 +23,53 @@ public:
     virtual uint32_t getColor() const{return 0xFF000000;}
     virtual void drawOverlay(cairo_t*){}
     virtual void apply(Canvas& canvas){(void)canvas;}
+    //copy in its current state for replaying recorded input, null when the
+    //tool cannot be replayed and history has to keep pixels instead
+    virtual std::unique_ptr<Tool> clone() const{return nullptr;}
+
+    //tools that only change document state (selections) skip the history snapshot
+    virtual bool editsPixels() const{return true;}
+    //false when the next press continues an edit already in the history (polygon vertices)
+    virtual bool beginsEdit() const{return true;}
+    //asked on release; false when the edit left the canvas as it was, and
+    //history drops the step it took for it
+    virtual bool editChangedPixels() const{return true;}
+    //pixel writes are clipped to this selection, null or inactive means everywhere
+    void setSelection(const Selection* s){selection = s;}
+    //tools that support it paint every copy, null or Off means just the input
+    virtual bool supportsSymmetry() const{return false;}
+    void setSymmetry(const Symmetry* s){symmetry = s;}
 
     virtual bool supportsSize() const{return false;}
     virtual void setSize(int s){(void)s;}
     virtual int getSize() const{return 1;}
+
+    virtual bool supportsBlendMode() const{return false;}
+    virtual void setBlendMode(BlendMode m){(void)m;}
+    virtual BlendMode getBlendMode() const{return BlendMode::Normal;}
+
+    virtual bool supportsSoftness() const{return false;}
+    virtual bool supportsHardness() const{return supportsSoftness();}
+    virtual void setAntialias(bool on){(void)on;}
+    virtual bool getAntialias() const{return false;}
+    virtual void setHardness(int h){(void)h;}
+    virtual int getHardness() const{return 100;}
+
+    virtual bool supportsTolerance() const{return false;}
+    virtual void setTolerance(int t){(void)t;}
+    virtual int getTolerance() const{return 0;}
+
+protected:
+    //runs fn(a, b) on the selected pieces of [x0, x1) on row y
+    template<class F>
+    void 
+    forSelected(int y, int x0, int x1, F&& fn) const{
+        if (selection) selection->clipSpan(y, x0, x1, fn);
+        else if (x0 < x1) fn(x0, x1);
+    }
+
+    const Selection* selection = nullptr;
+    const Symmetry* symmetry = nullptr;
 };
 
 #endif
@@ -0,0 +1,107 @@
+#ifdef PAINT_PROFILE
+
+#include <chrono>
+
+#include "trace.h"
+#include "profile.h"
+
+Tracer& 
+Tracer::shared(){
+    static Tracer instance;
+    return instance;
+}
+
+Tracer::~Tracer(){
+    stop();
+}
+
+bool 
+Tracer::start(const std::string& path){
+    if (active()) return true;
+    out = std::fopen(path.c_str(), "w");
+    if (!out) return false;
+
+    std::fputs("[\n", out);
+    firstEvent = true;
+    origin = Profiler::now();
+    stopping = false;
+    enabled = true;
+    flusher = std::thread(&Tracer::flushLoop, this);
+    return true;
+}
+
+void 
+Tracer::stop(){
+    if (!active()) return;
+    enabled = false;
+    stopping = true;
+    flusher.join();
+
+    //whatever the flusher did not get to yet
+    std::lock_guard<std::mutex> lock(ringsM);
+    for (auto& r : rings) drain(*r);
+    if (dropped.load())
+        std::fprintf(out, "%s{\"name\":\"dropped %llu events\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":0}",
+                     firstEvent ? "" : ",\n", static_cast<unsigned long long>(dropped.load()));
+    std::fputs("\n]\n", out);
+    std::fclose(out);
+    out = nullptr;
+}
+
+Tracer::Ring* 
+Tracer::threadRing(){
+    //rings belong to the tracer, so they outlive threads that exit mid-trace
+    thread_local Ring* ring = nullptr;
+    if (!ring){
+        std::lock_guard<std::mutex> lock(ringsM);
+        rings.push_back(std::make_unique<Ring>());
+        ring = rings.back().get();
+        ring->tid = static_cast<int>(rings.size());
+    }
+    return ring;
+}
+
+void 
+Tracer::span(const char* name, int64_t beginNs, int64_t endNs){
+    if (!active()) return;
+    Ring& r = *threadRing();
+    size_t h = r.head.load(std::memory_order_relaxed);
+    if (h - r.tail.load(std::memory_order_acquire) == Ring::SIZE){
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    r.events[h % Ring::SIZE] = {name, beginNs, endNs};
+    r.head.store(h + 1, std::memory_order_release);
+}
+
+void 
+Tracer::drain(Ring& r){
+    size_t t = r.tail.load(std::memory_order_relaxed);
+    size_t h = r.head.load(std::memory_order_acquire);
+    for (; t != h; ++t){
+        const Event& e = r.events[t % Ring::SIZE];
+        //complete events, timestamps in microseconds
+        std::fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                     firstEvent ? "" : ",\n", e.name, r.tid,
+                     (e.begin - origin) / 1000.0, (e.end - e.begin) / 1000.0);
+        firstEvent = false;
+    }
+    r.tail.store(h, std::memory_order_release);
+}
+
+void 
+Tracer::flushLoop(){
+    while (!stopping.load()){
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        std::lock_guard<std::mutex> lock(ringsM);
+        for (auto& r : rings) drain(*r);
+    }
+}
+
+TraceScope::TraceScope(const char* n) : name(n), start(Profiler::now()){}
+
+TraceScope::~TraceScope(){
+    Tracer::shared().span(name, start, Profiler::now());
+}
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Chrome/Perfetto trace-event export, part of PAINT_PROFILE builds.
+//Every thread appends complete spans to its own single-producer ring; a
+//background thread drains the rings into the JSON file, so recording a
+//span is two clock reads and a store. A full ring drops events instead
+//of blocking the painter.
+#ifdef PAINT_PROFILE
+
+class Tracer{
+public:
+    static Tracer& shared();
+    ~Tracer();
+
+    bool start(const std::string& path);
+    void stop();
+    bool active() const {return enabled.load(std::memory_order_relaxed);}
+
+    //name must outlive the tracer, string literals only
+    void span(const char* name, int64_t beginNs, int64_t endNs);
+
+private:
+    struct Event{
+        const char* name;
+        int64_t begin, end;
+    };
+
+    struct Ring{
+        static constexpr size_t SIZE = 1 << 14;
+        Event events[SIZE];
+        std::atomic<size_t> head{0};    //written by the owning thread
+        std::atomic<size_t> tail{0};    //written by the flusher
+        int tid = 0;
+    };
+
+    Tracer() = default;
+    Ring* threadRing();
+    void flushLoop();
+    void drain(Ring& ring);
+
+    std::mutex ringsM;
+    std::vector<std::unique_ptr<Ring>> rings;
+
+    std::atomic<bool> enabled{false};
+    std::atomic<bool> stopping{false};
+    std::thread flusher;
+    FILE* out = nullptr;
+    bool firstEvent = true;
+    int64_t origin = 0;
+    std::atomic<uint64_t> dropped{0};
+};
+
+class TraceScope{
+public:
+    explicit TraceScope(const char* n);
+    ~TraceScope();
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+#define TRACE_CAT2(a, b) a##b
+#define TRACE_CAT(a, b) TRACE_CAT2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CAT(traceScope_, __LINE__)(name)
+#define TRACE_START(path) Tracer::shared().start(path)
+#define TRACE_STOP() Tracer::shared().stop()
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_START(path) ((void)0)
+#define TRACE_STOP() ((void)0)
+
+#endif
+
+#endif
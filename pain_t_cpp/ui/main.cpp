@@ -1,27 +1,67 @@
 #include <gtk/gtk.h>
 #include <memory>
 #include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "../core/canvas.h"
+#include "../core/layer_stack.h"
 #include "../core/brush.h"
 #include "../core/fill.h"
 #include "../core/history.h"
 #include "../core/theme.h"
 #include "../core/tool.h"
 #include "../core/image_tool.h"
+#include "../core/selection.h"
+#include "../core/select_tool.h"
+#include "../core/shape_tool.h"
+#include "../core/gradient_tool.h"
+#include "../core/sample_brush.h"
+#include "../core/stamp_brush.h"
+#include "../core/filter.h"
+#include "../core/adjust_tool.h"
+#include "../core/clipboard.h"
+#include "../core/scheduler.h"
+#include "../core/profile.h"
+#include "../core/memory.h"
+#include "../core/renderer.h"
 
 
 //----------globals----------
-static History history;
-static std::unique_ptr<Canvas> canvas;
+//history, current_tool and selection are shared with the render thread and
+//only touched from renderer commands or inside renderer->sync()
+static std::unique_ptr<Renderer> renderer;
+//one undo tree per layer in stack order, `history` is the active layer's
+static std::vector<std::unique_ptr<History>> histories;
+static History* history = nullptr;
 static std::unique_ptr<Tool> current_tool;
+static Selection selection;
+static Symmetry symmetry;
 static bool drawing = false;
+//--board: layers are unbounded, the middle button drags the window over them
+static bool board_mode = false;
+static bool panning = false;
+static int pan_x = 0, pan_y = 0;
+//drag not yet applied to the board, a single queued command takes all of it
+static std::atomic<int> pan_dx{0}, pan_dy{0};
+static std::atomic<bool> pan_queued{false};
 static Theme* current_theme = &THEME_LIGHT;
 
 static GtkWidget *btn_undo = nullptr;
 static GtkWidget *btn_redo = nullptr;
+static GtkWidget *btn_branch = nullptr;
 static GtkWidget* color_button = nullptr;
 static GtkWidget* size_slider = nullptr;
+static GtkWidget* tolerance_slider = nullptr;
+static GtkWidget* smooth_toggle = nullptr;
+static GtkWidget* blend_combo = nullptr;
+static GtkWidget* symmetry_combo = nullptr;
+static GtkWidget* hardness_slider = nullptr;
+static GtkWidget* fill_progress = nullptr;
 static GtkWidget* area = nullptr;
 
 //for tool highlighting (maybe redundant?)
@@ -30,16 +70,38 @@ static GtkWidget* current_tool_button = nullptr;
 //----------------helpers----------------
 static void update_color_button();
 static void update_size_slider();
+static void update_tolerance_slider();
+static void update_softness_widgets();
+static void update_blend_combo();
 static void switch_tool(std::unique_ptr<Tool> tool);
 static void on_save(GtkButton* b, gpointer data);
 static void highlight_tool(GtkWidget* btn);
-
+static void select_layer(size_t idx);
+static void history_changed();
+static void layer_added(LayerStack& l, size_t idx);
+static History::ViewMover board_mover(LayerStack& l);
+static void change_tool(History::Setting change);
+static void on_undo(GtkWidget* w, gpointer data);
+static void on_redo(GtkWidget* w, gpointer data);
+static void on_branch(GtkWidget* w, gpointer data);
+
+//switch_tool applies whatever the current tool still holds
 static 
 void commit_current_tool(){
     if (!current_tool) return;
-    current_tool->apply(*canvas);
     switch_tool(std::make_unique<Brush>(0xFF000000, 4));
-    gtk_widget_queue_draw(area);
+}
+
+//applies what the tool still holds, a polygon being placed say, and keeps
+//the tool for the next one
+static 
+void apply_current_tool(){
+    renderer->post([](LayerStack& l){
+        if (!current_tool) return;
+        current_tool->apply(l.active());
+        history->applied(current_tool.get());
+        history_changed();
+    });
 }
 
 
@@ -48,20 +110,12 @@ static
 gboolean on_canvas_resize(GtkWidget*, GdkEventConfigure* event, gpointer){
     int new_w = event->width;
     int new_h = event->height;
-    if (!canvas || (canvas->getWidth() == new_w && canvas->getHeight() == new_h))
-        return FALSE;
+    if (!renderer) return FALSE;
 
-    auto new_canvas = std::make_unique<Canvas>(new_w, new_h);
-    new_canvas->clear(current_theme->background);
-
-    int copy_w = std::min(new_w, canvas->getWidth());
-    int copy_h = std::min(new_h, canvas->getHeight());
-    for (int y = 0; y < copy_h; y++)
-        std::copy_n(canvas->getPixels().data() + y * canvas->getWidth(),
-                    copy_w,
-                    new_canvas->getPixels().data() + y * new_w);
-
-    canvas = std::move(new_canvas);
+    renderer->sync([&](LayerStack& l){
+        if (l.getWidth() != new_w || l.getHeight() != new_h)
+            l.resize(new_w, new_h, current_theme->background);
+    });
     return TRUE;
 }
 
@@ -97,17 +151,88 @@ void apply_theme_css(GtkWidget*, Theme* theme){
     g_object_unref(css);
 }
 
+//call with the document held (command or sync), the buttons update on the main loop
+static 
+void history_changed(){
+    bool undo = history->canUndo(), redo = history->canRedo(), branch = history->canSwitchBranch();
+    runOnMainLoop([undo, redo, branch]{
+        gtk_widget_set_sensitive(btn_undo, undo);
+        gtk_widget_set_sensitive(btn_redo, redo);
+        gtk_widget_set_sensitive(btn_branch, branch);
+    });
+}
+
+//settings changed partway through an edit (colour between polygon
+//clicks, size during a stroke) are recorded with it for replay
 static 
-void update_history_buttons(){
-    gtk_widget_set_sensitive(btn_undo, history.canUndo());
-    gtk_widget_set_sensitive(btn_redo, history.canRedo());
+void change_tool(History::Setting change){
+    renderer->post([change](LayerStack&){
+        if (!current_tool) return;
+        change(*current_tool);
+        history->recordSetting(current_tool.get(), change);
+    });
+}
+
+//call with the document held once layer idx was inserted, it gets its own
+//undo tree and becomes the one edits go to
+static 
+void layer_added(LayerStack& l, size_t idx){
+    histories.insert(histories.begin() + idx, std::make_unique<History>(4096, History::Mode::Commands));
+    history = histories[idx].get();
+    history->moved(l.originX(), l.originY());
+    history_changed();
+}
+
+//board mode: shows the board from (x, y); every layer's history and the
+//selection follow the window. `navigating` is in the middle of moving
+//between states and must not be settled.
+static 
+void move_board(LayerStack& l, int x, int y, History* navigating){
+    int dx = x - l.originX(), dy = y - l.originY();
+    if (!dx && !dy) return;
+    for (size_t i = 0; i < l.count(); ++i)
+        if (histories[i].get() != navigating) histories[i]->settle(*l.layer(i).canvas);
+    l.pan(dx, dy);
+    for (auto& h : histories) h->moved(x, y);
+    //the selection stays on the part of the board it was made on
+    selection.translate(-dx, -dy);
+}
+
+//lets undo and redo move the window back to where a state was made
+static 
+History::ViewMover board_mover(LayerStack& l){
+    if (!l.isBoard()) return {};
+    return [&l](int x, int y){move_board(l, x, y, history);};
+}
+
+//large fills report from the render thread and its workers; the bar
+//follows on the main loop in whole percent steps and hides once done
+static 
+void on_fill_progress(float done){
+    static std::atomic<int> shown{-1};
+    int percent = static_cast<int>(done * 100.0f);
+    if (shown.exchange(percent) == percent) return;
+    runOnMainLoop([percent]{
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(fill_progress), percent / 100.0);
+        gtk_widget_set_visible(fill_progress, percent < 100);
+    });
+}
+
+static 
+std::unique_ptr<Fill> new_fill(){
+    auto fill = std::make_unique<Fill>(current_theme->foreground);
+    fill->setProgressCallback(on_fill_progress);
+    return fill;
 }
 
 static 
 void pick_color_at(int x, int y){
     if (!current_tool || !current_tool->usesColor()) return;
-    uint32_t color = canvas->getPixel(x, y);
-    current_tool->setColor(color);
+    //what the user sees is the last published frame
+    const Renderer::Frame& f = renderer->frame();
+    if (x < 0 || y < 0 || x >= f.width || y >= f.height) return;
+    uint32_t color = f.pixels[static_cast<size_t>(y) * f.width + x];
+    change_tool([color](Tool& t){t.setColor(color);});
 
     GdkRGBA rgba ={
         .red   = ((color >> 16) & 0xFF) / 255.0,
@@ -131,7 +256,26 @@ void on_save(GtkButton* /*b*/, gpointer data){
 
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT){
         char* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        canvas->savePNG(filename);
+        //encode a snapshot on the pool, painting can go on meanwhile
+        std::shared_ptr<const std::vector<uint32_t>> pixels;
+        int w = 0, h = 0;
+        renderer->sync([&](LayerStack& l){
+            //a board saves everything painted on it, not just the window
+            if (l.isBoard()){
+                pixels = l.flattenBoard(w, h);
+                return;
+            }
+            const Canvas& flat = l.composite();
+            pixels = flat.snapshot();
+            w = flat.getWidth();
+            h = flat.getHeight();
+        });
+        std::string path = filename;
+        Scheduler::shared().async<bool>([pixels, w, h, path]{
+            return Canvas::writePNG(*pixels, w, h, path);
+        }).then([path](bool& ok){
+            if (!ok) g_printerr("Could not save %s\n", path.c_str());
+        });
         g_free(filename);
     }
 
@@ -139,98 +283,545 @@ void on_save(GtkButton* /*b*/, gpointer data){
 }
 
 static 
-gboolean on_draw(GtkWidget*, cairo_t* cr, gpointer){
-    if (!canvas) return FALSE;
-
-    cairo_surface_t *surface = cairo_image_surface_create_for_data(
-        reinterpret_cast<unsigned char*>(canvas->getPixels().data()),
-        CAIRO_FORMAT_ARGB32,
-        canvas->getWidth(),
-        canvas->getHeight(),
-        canvas->getWidth() * 4
+void on_blur(GtkButton* /*b*/, gpointer data){
+    GtkWidget* dialog = gtk_dialog_new_with_buttons(
+        "Blur", GTK_WINDOW(data), GTK_DIALOG_MODAL,
+        "_Cancel", GTK_RESPONSE_CANCEL,
+        "_Apply", GTK_RESPONSE_ACCEPT, NULL
+    );
+    GtkWidget* content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget* radius = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 1, 200, 1);
+    GtkWidget* box = gtk_check_button_new_with_label("Box blur");
+    gtk_range_set_value(GTK_RANGE(radius), 4);
+    gtk_widget_set_size_request(radius, 240, -1);
+    gtk_box_pack_start(GTK_BOX(content), radius, TRUE, TRUE, 4);
+    gtk_box_pack_start(GTK_BOX(content), box, FALSE, FALSE, 4);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT){
+        apply_current_tool();
+
+        //runs on the render thread, the window stays responsive on big canvases
+        int r = static_cast<int>(gtk_range_get_value(GTK_RANGE(radius)));
+        bool boxBlur = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(box));
+        renderer->post([r, boxBlur](LayerStack& l){
+            history->push(l.active());
+            history_changed();
+            if (boxBlur)
+                Filter::boxBlur(l.active(), r, &selection);
+            else
+                Filter::gaussianBlur(l.active(), r / 2.0f, &selection);
+        });
+    }
+
+    gtk_widget_destroy(dialog);
+}
+
+struct AdjustWidgets{
+    AdjustTool* tool;
+    GtkWidget* brightness;
+    GtkWidget* contrast;
+    GtkWidget* black;
+    GtkWidget* white;
+    GtkWidget* hue;
+    GtkWidget* saturation;
+    GtkWidget* invert;
+};
+
+static 
+void on_adjust_changed(GtkWidget*, gpointer data){
+    auto* aw = static_cast<AdjustWidgets*>(data);
+    AdjustParams p;
+    p.brightness = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->brightness)));
+    p.contrast   = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->contrast)));
+    p.levelsLow  = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->black)));
+    p.levelsHigh = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->white)));
+    p.hue        = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->hue)));
+    p.saturation = static_cast<int>(gtk_range_get_value(GTK_RANGE(aw->saturation)));
+    p.invert     = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(aw->invert));
+
+    //only the proxy is re-rendered here
+    renderer->sync([&](LayerStack&){aw->tool->setParams(p);});
+}
+
+static 
+void on_adjust(GtkButton* /*b*/, gpointer data){
+    commit_current_tool();
+    std::unique_ptr<AdjustTool> tool;
+    renderer->sync([&](LayerStack& l){tool = std::make_unique<AdjustTool>(l.active());});
+    AdjustWidgets aw = {tool.get(), nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    switch_tool(std::move(tool));
+
+    GtkWidget* dialog = gtk_dialog_new_with_buttons(
+        "Adjust colours", GTK_WINDOW(data), GTK_DIALOG_DESTROY_WITH_PARENT,
+        "_Cancel", GTK_RESPONSE_CANCEL,
+        "_Apply", GTK_RESPONSE_ACCEPT, NULL
     );
+    GtkWidget* content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+
+    auto slider = [&](const char* label, double lo, double hi, double value){
+        GtkWidget* s = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, lo, hi, 1);
+        gtk_range_set_value(GTK_RANGE(s), value);
+        gtk_widget_set_size_request(s, 240, -1);
+        gtk_box_pack_start(GTK_BOX(content), gtk_label_new(label), FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(content), s, FALSE, FALSE, 2);
+        g_signal_connect(s, "value-changed", G_CALLBACK(on_adjust_changed), &aw);
+        return s;
+    };
+    aw.brightness = slider("Brightness", -100, 100, 0);
+    aw.contrast   = slider("Contrast", -100, 100, 0);
+    aw.black      = slider("Levels black", 0, 254, 0);
+    aw.white      = slider("Levels white", 1, 255, 255);
+    aw.hue        = slider("Hue", -180, 180, 0);
+    aw.saturation = slider("Saturation", -100, 100, 0);
+    aw.invert = gtk_check_button_new_with_label("Invert");
+    gtk_box_pack_start(GTK_BOX(content), aw.invert, FALSE, FALSE, 2);
+    g_signal_connect(aw.invert, "toggled", G_CALLBACK(on_adjust_changed), &aw);
+    gtk_widget_show_all(dialog);
+
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT){
+        //one history entry for the whole full resolution pass
+        renderer->sync([](LayerStack& l){
+            history->push(l.active());
+            history_changed();
+        });
+    } else{
+        renderer->sync([&](LayerStack&){aw.tool->cancel();});
+    }
+    gtk_widget_destroy(dialog);
+    commit_current_tool();
+}
 
-    cairo_set_source_surface(cr, surface, 0, 0);
+static 
+void draw_canvas(cairo_t* cr){
+    const Renderer::Frame& f = renderer->frame();
+
+    PROFILE_SCOPE(ProfileStage::Cairo, "cairo paint");
+
+    //erased pixels are transparent, show the theme background through them
+    uint32_t bg = current_theme->background;
+    cairo_set_source_rgb(cr, ((bg >> 16) & 0xFF) / 255.0, ((bg >> 8) & 0xFF) / 255.0, (bg & 0xFF) / 255.0);
     cairo_paint(cr);
 
-    if (current_tool){
-        current_tool->drawOverlay(cr);
+    if (f.width > 0 && f.height > 0){
+        cairo_surface_t *surface = cairo_image_surface_create_for_data(
+            reinterpret_cast<unsigned char*>(const_cast<uint32_t*>(f.pixels.data())),
+            CAIRO_FORMAT_ARGB32,
+            f.width,
+            f.height,
+            f.width * 4
+        );
+        cairo_set_source_surface(cr, surface, 0, 0);
+        cairo_paint(cr);
+        cairo_surface_destroy(surface);
     }
-    cairo_surface_destroy(surface);
+
+    //overlays read tool state; if the render thread is busy they wait for
+    //the frame it is about to publish instead of blocking the UI
+    renderer->trySync([&](LayerStack&){
+        selection.drawOutline(cr);
+        if (current_tool && current_tool->supportsSymmetry()) symmetry.drawGuides(cr, f.width, f.height);
+        if (current_tool) current_tool->drawOverlay(cr);
+    });
+}
+
+static 
+gboolean on_draw(GtkWidget*, cairo_t* cr, gpointer){
+    if (!renderer) return FALSE;
+
+    {
+        PROFILE_SCOPE(ProfileStage::Draw, "on_draw");
+        draw_canvas(cr);
+    }
+    PROFILE_FRAME(static_cast<int64_t>(renderer->frame().damage.w) * renderer->frame().damage.h);
+    PROFILE_DROPPED_MOTION(renderer->droppedMotionEvents());
+    PROFILE_HUD(cr);
     return FALSE;
 }
 
+//pointer callbacks only record the event, the render thread applies it and
+//asks for a redraw once it has caught up
+static 
+void apply_input(LayerStack& l, const InputEvent& e){
+    if (!current_tool) return;
+    switch (e.kind){
+        case InputKind::Press:
+            if (current_tool->editsPixels() && current_tool->beginsEdit()){
+                //replays ignore the selection, edits clipped to one keep pixels
+                history->push(l.active(), selection.isActive() ? nullptr : current_tool.get(), &symmetry);
+                history_changed();
+            }
+            {
+                PROFILE_SCOPE(ProfileStage::Tool, "Tool::press");
+                current_tool->press(l.active(), e.x, e.y);
+            }
+            break;
+        case InputKind::Drag:{
+            PROFILE_SCOPE(ProfileStage::Tool, "Tool::drag");
+            current_tool->drag(l.active(), e.x, e.y);
+            break;
+        }
+        case InputKind::Release:{
+            PROFILE_SCOPE(ProfileStage::Tool, "Tool::release");
+            current_tool->release(l.active(), e.x, e.y);
+            break;
+        }
+        case InputKind::Command:
+            break;
+    }
+    history->record(current_tool.get(), e);
+    //a gradient click without a drag leaves nothing to undo
+    if (e.kind == InputKind::Release && !current_tool->editChangedPixels()){
+        history->discard(current_tool.get());
+        history_changed();
+    }
+}
+
 static 
 gboolean on_button_press(GtkWidget*, GdkEventButton* event, gpointer){
     if (event->button == 3){
         pick_color_at((int)event->x, (int)event->y);
         return TRUE;
     }
+    if (event->button == 2 && board_mode && renderer){
+        //a shape still being placed is in window coordinates, finish it here
+        apply_current_tool();
+        panning = true;
+        pan_x = (int)event->x;
+        pan_y = (int)event->y;
+        return TRUE;
+    }
     if (event->button != 1) return FALSE;
 
     drawing = true;
-    if (!canvas) return FALSE;
-
-    history.push(*canvas);
-    update_history_buttons();
-
-    if (current_tool) current_tool->press(*canvas, event->x, event->y);
-
-    gtk_widget_queue_draw(area);
+    if (!renderer) return FALSE;
+    PROFILE_INPUT();
+    renderer->input({InputKind::Press, (int32_t)event->x, (int32_t)event->y, event->time});
     return TRUE;
 }
 
 static 
 gboolean on_button_release(GtkWidget*, GdkEventButton* event, gpointer){
+    if (event->button == 2 && panning){
+        panning = false;
+        return TRUE;
+    }
     drawing = false;
-    if (current_tool) current_tool->release(*canvas, event->x, event->y);
-    gtk_widget_queue_draw(area);
+    if (!renderer) return FALSE;
+    PROFILE_INPUT();
+    renderer->input({InputKind::Release, (int32_t)event->x, (int32_t)event->y, event->time});
     return TRUE;
 }
 
 static 
 gboolean on_motion(GtkWidget*, GdkEventMotion* event, gpointer){
-    if (!drawing || !current_tool) return FALSE;
-    current_tool->drag(*canvas, event->x, event->y);
-    gtk_widget_queue_draw(area);
+    if (panning && renderer){
+        //the board follows the pointer
+        pan_dx += pan_x - (int)event->x;
+        pan_dy += pan_y - (int)event->y;
+        pan_x = (int)event->x;
+        pan_y = (int)event->y;
+        //motion arriving faster than frames piles up here, one move per frame
+        if (!pan_queued.exchange(true)){
+            renderer->post([](LayerStack& l){
+                pan_queued = false;
+                int dx = pan_dx.exchange(0), dy = pan_dy.exchange(0);
+                move_board(l, l.originX() + dx, l.originY() + dy, nullptr);
+            });
+        }
+        return TRUE;
+    }
+    if (!drawing || !renderer) return FALSE;
+    PROFILE_INPUT();
+    renderer->input({InputKind::Drag, (int32_t)event->x, (int32_t)event->y, event->time});
     return TRUE;
 }
 
+//--------------clipboard paste----------------
+//ctrl+v never blocks: targets and bytes arrive through async requests,
+//decoding runs on the pool and the pixels are handed back on the main loop
+struct PasteJob{
+    guint serial = 0;
+    std::vector<guchar> bytes;
+    std::vector<uint32_t> pixels;
+    int width = 0, height = 0;
+};
+
+static guint paste_serial = 0;
+static ImageTool* pending_paste = nullptr;
+
+static constexpr int PASTE_PLACEHOLDER_W = 200;
+static constexpr int PASTE_PLACEHOLDER_H = 150;
+
+static 
+void on_paste_decoded(PasteJob* job){
+    //a newer paste or a tool switch made this one stale
+    if (job->serial != paste_serial || current_tool.get() != pending_paste) return;
+    pending_paste = nullptr;
+
+    if (job->pixels.empty()){
+        commit_current_tool();
+        return;
+    }
+
+    //pasted images land on their own layer instead of stamping over the artwork
+    renderer->sync([&](LayerStack& l){
+        static_cast<ImageTool*>(current_tool.get())->setImage(std::move(job->pixels), job->width, job->height);
+        layer_added(l, l.addLayer("Pasted image"));
+    });
+}
+
+static 
+void decode_paste(PasteJob* job){
+    GdkPixbufLoader* loader = gdk_pixbuf_loader_new();
+    bool ok = gdk_pixbuf_loader_write(loader, job->bytes.data(), job->bytes.size(), nullptr);
+    ok = gdk_pixbuf_loader_close(loader, nullptr) && ok;
+    GdkPixbuf* pix = ok ? gdk_pixbuf_loader_get_pixbuf(loader) : nullptr;
+    if (pix){
+        job->width = gdk_pixbuf_get_width(pix);
+        job->height = gdk_pixbuf_get_height(pix);
+        ImageTool::convertPixbuf(pix, job->pixels);
+    }
+    g_object_unref(loader);
+
+    job->bytes = std::vector<guchar>();
+}
+
+static 
+void on_paste_contents(GtkClipboard*, GtkSelectionData* data, gpointer user){
+    auto job = std::make_shared<PasteJob>();
+    job->serial = GPOINTER_TO_UINT(user);
+    gint len = gtk_selection_data_get_length(data);
+    if (job->serial != paste_serial || len <= 0){
+        on_paste_decoded(job.get());
+        return;
+    }
+
+    const guchar* bytes = gtk_selection_data_get_data(data);
+    job->bytes.assign(bytes, bytes + len);
+    Scheduler::shared().async<std::shared_ptr<PasteJob>>([job]{
+        decode_paste(job.get());
+        return job;
+    }).then([](std::shared_ptr<PasteJob>& done){
+        on_paste_decoded(done.get());
+    });
+}
+
+static 
+void on_paste_targets(GtkClipboard* cb, GdkAtom* atoms, gint n, gpointer user){
+    if (GPOINTER_TO_UINT(user) != paste_serial || !atoms || !gtk_targets_include_image(atoms, n, FALSE)) return;
+
+    //png is lossless and always decodable, otherwise take the first image target offered
+    GdkAtom target = nullptr;
+    GdkAtom png = gdk_atom_intern_static_string("image/png");
+    for (gint i = 0; i < n; ++i){
+        if (atoms[i] == png){
+            target = png;
+            break;
+        }
+        if (!target && gtk_targets_include_image(atoms + i, 1, FALSE)) target = atoms[i];
+    }
+
+    auto placeholder = std::make_unique<ImageTool>(PASTE_PLACEHOLDER_W, PASTE_PLACEHOLDER_H);
+    ImageTool* tool = placeholder.get();
+    switch_tool(std::move(placeholder));
+    pending_paste = tool;
+
+    gtk_clipboard_request_contents(cb, target, on_paste_contents, user);
+}
+
+static 
+void request_paste(){
+    GtkClipboard* cb = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    gtk_clipboard_request_targets(cb, on_paste_targets, GUINT_TO_POINTER(++paste_serial));
+}
+
+//--------------clipboard copy----------------
+//only the target list is announced, pixels are encoded when someone pastes
+static 
+void on_copy_get(GtkClipboard*, GtkSelectionData* data, guint, gpointer user){
+    GdkPixbuf* pix = static_cast<ClipboardImage*>(user)->pixbuf();
+    if (pix) gtk_selection_data_set_pixbuf(data, pix);
+}
+
+static 
+void on_copy_clear(GtkClipboard*, gpointer user){
+    delete static_cast<ClipboardImage*>(user);
+}
+
+static 
+void copy_to_clipboard(bool merged){
+    std::unique_ptr<ClipboardImage> image;
+    renderer->sync([&](LayerStack& l){
+        const Canvas& src = merged ? l.composite() : l.active();
+        image = std::make_unique<ClipboardImage>(src, selection);
+    });
+    if (image->empty()) return;
+
+    GtkTargetList* list = gtk_target_list_new(nullptr, 0);
+    gtk_target_list_add_image_targets(list, 0, TRUE);
+    gint n = 0;
+    GtkTargetEntry* targets = gtk_target_table_new_from_list(list, &n);
+
+    GtkClipboard* cb = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
+    if (gtk_clipboard_set_with_data(cb, targets, n, on_copy_get, on_copy_clear, image.get())){
+        image.release(); //owned by the clipboard until on_copy_clear
+        //lets a clipboard manager keep the image after we quit
+        gtk_clipboard_set_can_store(cb, nullptr, 0);
+    }
+
+    gtk_target_table_free(targets, n);
+    gtk_target_list_unref(list);
+}
+
+//--------------memory report----------------
+static 
+void show_memory_report(GtkWindow* parent){
+    GtkWidget* dialog = gtk_dialog_new_with_buttons(
+        "Memory", parent, GTK_DIALOG_MODAL,
+        "_Close", GTK_RESPONSE_CLOSE, NULL
+    );
+    GtkWidget* content = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+    GtkWidget* label = gtk_label_new(MemoryStats::report().c_str());
+    gtk_label_set_selectable(GTK_LABEL(label), TRUE);
+    gtk_style_context_add_class(gtk_widget_get_style_context(label), "monospace");
+    gtk_box_pack_start(GTK_BOX(content), label, TRUE, TRUE, 8);
+    gtk_widget_show_all(dialog);
+    gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+}
+
+//paint --memory-report WxH [LAYERS] prints what a canvas of that size costs
+//with one undo step per layer, without opening a window
+static 
+int run_memory_report(int argc, char** argv){
+    int w = 0, h = 0, count = 1;
+    if (argc < 3 || std::sscanf(argv[2], "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0){
+        std::fprintf(stderr, "usage: %s --memory-report WIDTHxHEIGHT [LAYERS]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 3) count = std::max(1, std::atoi(argv[3]));
+
+    LayerStack stack(w, h, 0xFFFFFFFF);
+    History hist;
+    for (int i = 1; i < count; ++i) stack.addLayer("Layer");
+    for (size_t i = 0; i < stack.count(); ++i){
+        stack.setActive(i);
+        hist.push(stack.active());
+    }
+    stack.composite();
+
+    std::printf("%dx%d, %d layer(s)\n%s", w, h, count, MemoryStats::report().c_str());
+    return 0;
+}
+
 static 
 gboolean on_key_press(GtkWidget* w, GdkEventKey* e, gpointer){
     if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_z){
-        if (history.undo(*canvas)) gtk_widget_queue_draw(w);
-        update_history_buttons();
+        on_undo(w, nullptr);
         return TRUE;
     }
     if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_y){
-        if (history.redo(*canvas)) gtk_widget_queue_draw(w);
-        update_history_buttons();
+        on_redo(w, nullptr);
+        return TRUE;
+    }
+    if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_b){
+        on_branch(w, nullptr);
+        return TRUE;
+    }
+    //with shift: one state older or newer by the time it was made, any branch
+    if ((e->state & GDK_CONTROL_MASK) && (e->keyval == GDK_KEY_Z || e->keyval == GDK_KEY_Y)){
+        int steps = e->keyval == GDK_KEY_Z ? -1 : 1;
+        renderer->post([steps](LayerStack& l){
+            history->travel(l.active(), steps, board_mover(l));
+            history_changed();
+        });
+        return TRUE;
+    }
+    if (e->keyval == GDK_KEY_F4){
+        show_memory_report(GTK_WINDOW(gtk_widget_get_toplevel(w)));
+        return TRUE;
+    }
+    if (e->keyval == GDK_KEY_F3){
+        //performance HUD, only present in PROFILE=1 builds
+        PROFILE_TOGGLE_HUD();
+        gtk_widget_queue_draw(area);
         return TRUE;
     }
     if (e->keyval == GDK_KEY_t){
         current_theme = (current_theme == &THEME_LIGHT) ? &THEME_DARK : &THEME_LIGHT;
         apply_theme_css(w, current_theme);
+        gtk_widget_queue_draw(area);
+        return TRUE;
+    }
+    if ((e->state & GDK_CONTROL_MASK) && (e->keyval == GDK_KEY_c || e->keyval == GDK_KEY_C)){
+        //shift copies what is visible, plain ctrl+c only the active layer
+        copy_to_clipboard(e->state & GDK_SHIFT_MASK);
         return TRUE;
     }
     if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_v){
-        GtkClipboard* cb = gtk_clipboard_get(GDK_SELECTION_CLIPBOARD);
-        if (gtk_clipboard_wait_is_image_available(cb)){
-            GdkPixbuf* pixbuf = gtk_clipboard_wait_for_image(cb);
-            if (pixbuf){
-                switch_tool(std::make_unique<ImageTool>(pixbuf));
-            }
-        }
+        request_paste();
         return TRUE;
     }
-    if (e->keyval == GDK_KEY_Return){
+    if ((e->state & GDK_CONTROL_MASK) && (e->keyval == GDK_KEY_n || e->keyval == GDK_KEY_N)){
         commit_current_tool();
+        renderer->sync([](LayerStack& l){
+            layer_added(l, l.addLayer("Layer"));
+        });
+        return TRUE;
+    }
+    if (e->keyval == GDK_KEY_Page_Up || e->keyval == GDK_KEY_Page_Down){
+        size_t idx = 0, count = 0;
+        renderer->sync([&](LayerStack& l){
+            idx = l.activeIndex();
+            count = l.count();
+        });
+        if (e->keyval == GDK_KEY_Page_Up && idx + 1 < count) ++idx;
+        if (e->keyval == GDK_KEY_Page_Down && idx > 0) --idx;
+        select_layer(idx);
+        return TRUE;
+    }
+    if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_h){
+        renderer->post([](LayerStack& l){
+            size_t idx = l.activeIndex();
+            l.setVisible(idx, !l.layer(idx).visible);
+        });
+        return TRUE;
+    }
+    if ((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_a){
+        renderer->post([](LayerStack& l){
+            selection.selectRect(l.getWidth(), l.getHeight(), {0, 0, l.getWidth(), l.getHeight()});
+        });
+        return TRUE;
+    }
+    if (((e->state & GDK_CONTROL_MASK) && e->keyval == GDK_KEY_d) || e->keyval == GDK_KEY_Escape){
+        renderer->post([](LayerStack&){selection.clear();});
+        return TRUE;
+    }
+    if (e->keyval == GDK_KEY_Return){
+        //a placed paste is finished with, other tools stay selected
+        bool pasting = false;
+        renderer->sync([&](LayerStack&){pasting = dynamic_cast<ImageTool*>(current_tool.get()) != nullptr;});
+        if (pasting) commit_current_tool();
+        else apply_current_tool();
         return TRUE;
     }
 
     return FALSE;
 }
 
+//--------------layers--------------------
+static void 
+select_layer(size_t idx){
+    commit_current_tool();
+    renderer->sync([idx](LayerStack& l){
+        if (idx == l.activeIndex()) return;
+        l.setActive(idx);
+        history = histories[idx].get();
+        history_changed();
+    });
+}
+
 //--------------tool/color/size-----------
 static void 
 update_color_button(){
@@ -262,13 +853,56 @@ update_size_slider(){
     gtk_range_set_value(GTK_RANGE(size_slider), current_tool->getSize());
 }
 
+static void 
+update_blend_combo(){
+    if (!blend_combo || !current_tool) return;
+    if (!current_tool->supportsBlendMode()){
+        gtk_widget_set_sensitive(blend_combo, FALSE);
+        return;
+    }
+    gtk_widget_set_sensitive(blend_combo, TRUE);
+    gtk_combo_box_set_active(GTK_COMBO_BOX(blend_combo), static_cast<int>(current_tool->getBlendMode()));
+}
+
+static void 
+update_softness_widgets(){
+    if (!smooth_toggle || !hardness_slider || !current_tool) return;
+    bool soft = current_tool->supportsSoftness();
+    gtk_widget_set_sensitive(smooth_toggle, soft);
+    gtk_widget_set_sensitive(hardness_slider, current_tool->supportsHardness() && current_tool->getAntialias());
+    if (soft) gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(smooth_toggle), current_tool->getAntialias());
+    if (current_tool->supportsHardness()) gtk_range_set_value(GTK_RANGE(hardness_slider), current_tool->getHardness());
+}
+
+static void 
+update_tolerance_slider(){
+    if (!tolerance_slider || !current_tool) return;
+    if (!current_tool->supportsTolerance()){
+        gtk_widget_set_sensitive(tolerance_slider, FALSE);
+        return;
+    }
+    gtk_widget_set_sensitive(tolerance_slider, TRUE);
+    gtk_range_set_value(GTK_RANGE(tolerance_slider), current_tool->getTolerance());
+}
+
 static void 
 switch_tool(std::unique_ptr<Tool> tool){
-    if (current_tool) current_tool->apply(*canvas); 
-    current_tool = std::move(tool);
-    update_color_button();
-    update_size_slider();
-    gtk_widget_queue_draw(area);
+    //queued input for the old tool runs first, the widgets read the new one
+    //while the render thread cannot touch it
+    renderer->sync([&](LayerStack& l){
+        if (current_tool){
+            current_tool->apply(l.active());
+            history->applied(current_tool.get());
+        }
+        current_tool = std::move(tool);
+        if (current_tool) current_tool->setSelection(&selection);
+        if (current_tool) current_tool->setSymmetry(&symmetry);
+        update_color_button();
+        update_size_slider();
+        update_tolerance_slider();
+        update_softness_widgets();
+        update_blend_combo();
+    });
 }
 
 
@@ -292,27 +926,169 @@ on_tool_brush(GtkWidget* btn, gpointer){
 
 void 
 on_tool_eraser(GtkWidget* btn, gpointer){
-    switch_tool(std::make_unique<Brush>(0xFFFFFFFF, 8));
+    switch_tool(std::make_unique<Brush>(0xFFFFFFFF, 8, BlendMode::Erase));
     highlight_tool(btn);
 }
 
 void 
 on_tool_fill(GtkWidget* btn, gpointer){
-    switch_tool(std::make_unique<Fill>(current_theme->foreground));
+    switch_tool(new_fill());
+    highlight_tool(btn);
+}
+
+void 
+on_tool_select(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SelectTool>(selection, SelectTool::Shape::Rectangle));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_lasso(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SelectTool>(selection, SelectTool::Shape::Lasso));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_wand(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SelectTool>(selection, SelectTool::Shape::Wand));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_line(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<ShapeTool>(current_theme->foreground, ShapeTool::Shape::Line));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_rectangle(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<ShapeTool>(current_theme->foreground, ShapeTool::Shape::Rectangle));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_ellipse(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<ShapeTool>(current_theme->foreground, ShapeTool::Shape::Ellipse));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_polygon(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<ShapeTool>(current_theme->foreground, ShapeTool::Shape::Polygon));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_gradient(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<GradientTool>(current_theme->foreground, current_theme->background, GradientTool::Kind::Linear));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_radial(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<GradientTool>(current_theme->foreground, current_theme->background, GradientTool::Kind::Radial));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_smudge(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SampleBrush>(SampleBrush::Mode::Smudge));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_soften(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SampleBrush>(SampleBrush::Mode::Soften));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_clone(GtkWidget* btn, gpointer){
+    switch_tool(std::make_unique<SampleBrush>(SampleBrush::Mode::Clone));
+    highlight_tool(btn);
+}
+
+//asks for an image file, false when cancelled or unreadable
+static 
+bool choose_image(GtkWidget* from, const char* title, std::vector<uint32_t>& pixels, int& w, int& h){
+    GtkWidget* dialog = gtk_file_chooser_dialog_new(
+        title, GTK_WINDOW(gtk_widget_get_toplevel(from)), GTK_FILE_CHOOSER_ACTION_OPEN,
+        "_Cancel", GTK_RESPONSE_CANCEL,
+        "_Open", GTK_RESPONSE_ACCEPT, NULL
+    );
+    bool ok = false;
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT){
+        char* filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        GError* err = nullptr;
+        GdkPixbuf* pix = gdk_pixbuf_new_from_file(filename, &err);
+        if (pix){
+            w = gdk_pixbuf_get_width(pix);
+            h = gdk_pixbuf_get_height(pix);
+            ImageTool::convertPixbuf(pix, pixels);
+            g_object_unref(pix);
+            ok = w > 0 && h > 0;
+        } else{
+            g_printerr("Could not open %s: %s\n", filename, err ? err->message : "unknown error");
+            if (err) g_error_free(err);
+        }
+        g_free(filename);
+    }
+    gtk_widget_destroy(dialog);
+    return ok;
+}
+
+//last tip and pattern picked, cancelling the dialog keeps using them
+static std::shared_ptr<StampCache> stamp_tip;
+static std::shared_ptr<const Pattern> fill_pattern;
+
+void 
+on_tool_stamp(GtkWidget* btn, gpointer){
+    std::vector<uint32_t> pixels;
+    int w = 0, h = 0;
+    if (choose_image(btn, "Brush Tip", pixels, w, h))
+        stamp_tip = std::make_shared<StampCache>(pixels, w, h);
+    if (!stamp_tip) return;
+    switch_tool(std::make_unique<StampBrush>(0xFF000000, stamp_tip));
+    highlight_tool(btn);
+}
+
+void 
+on_tool_pattern(GtkWidget* btn, gpointer){
+    std::vector<uint32_t> pixels;
+    int w = 0, h = 0;
+    if (choose_image(btn, "Fill Pattern", pixels, w, h))
+        fill_pattern = std::make_shared<const Pattern>(pixels, w, h);
+    if (!fill_pattern) return;
+    auto fill = new_fill();
+    fill->setPattern(fill_pattern);
+    switch_tool(std::move(fill));
     highlight_tool(btn);
 }
 
 //--------------undo/redo---------------
 static void 
 on_undo(GtkWidget*, gpointer){
-    if (history.undo(*canvas)) gtk_widget_queue_draw(area);
-    update_history_buttons();
+    renderer->post([](LayerStack& l){
+        history->undo(l.active(), board_mover(l));
+        history_changed();
+    });
 }
 
 static void 
 on_redo(GtkWidget*, gpointer){
-    if (history.redo(*canvas)) gtk_widget_queue_draw(area);
-    update_history_buttons();
+    renderer->post([](LayerStack& l){
+        history->redo(l.active(), board_mover(l));
+        history_changed();
+    });
+}
+
+//edits made after an undo are kept side by side, this flips between them
+static void 
+on_branch(GtkWidget*, gpointer){
+    renderer->post([](LayerStack& l){
+        history->switchBranch(l.active(), board_mover(l));
+        history_changed();
+    });
 }
 
 static void 
@@ -326,26 +1102,86 @@ on_color_changed(GtkColorButton* btn, gpointer){
         ((uint8_t)(rgba.red   * 255) << 16) |
         ((uint8_t)(rgba.green * 255) << 8) |
         ((uint8_t)(rgba.blue  * 255));
-    current_tool->setColor(color);
+    change_tool([color](Tool& t){t.setColor(color);});
 }
 
 static void 
 on_size_changed(GtkRange* range, gpointer){
     if (!current_tool || !current_tool->supportsSize()) return;
-    current_tool->setSize(static_cast<int>(gtk_range_get_value(range)));
+    int size = static_cast<int>(gtk_range_get_value(range));
+    change_tool([size](Tool& t){t.setSize(size);});
+}
+
+static void 
+on_tolerance_changed(GtkRange* range, gpointer){
+    if (!current_tool || !current_tool->supportsTolerance()) return;
+    int tolerance = static_cast<int>(gtk_range_get_value(range));
+    change_tool([tolerance](Tool& t){t.setTolerance(tolerance);});
+}
+
+static void 
+on_blend_changed(GtkComboBox* combo, gpointer){
+    if (!current_tool || !current_tool->supportsBlendMode()) return;
+    int idx = gtk_combo_box_get_active(combo);
+    if (idx >= 0) change_tool([idx](Tool& t){t.setBlendMode(static_cast<BlendMode>(idx));});
+}
+
+//entries: off, the three mirrors, then radial folds
+static const int SYMMETRY_FOLDS[] = {3, 4, 6, 8};
+
+static void 
+on_symmetry_changed(GtkComboBox* combo, gpointer){
+    int idx = gtk_combo_box_get_active(combo);
+    if (idx < 0) return;
+    Symmetry s;
+    if (idx <= 3){
+        s.mode = static_cast<Symmetry::Mode>(idx);
+    } else{
+        s.mode = Symmetry::Mode::Radial;
+        s.folds = SYMMETRY_FOLDS[idx - 4];
+    }
+    renderer->post([s](LayerStack&){
+        symmetry = s;
+        //an edit in progress replays with the new symmetry from here on
+        auto kept = std::make_shared<const Symmetry>(s);
+        if (current_tool) history->recordSetting(current_tool.get(), [kept](Tool& t){t.setSymmetry(kept.get());});
+    });
+}
+
+static void 
+on_smooth_toggled(GtkToggleButton* btn, gpointer){
+    if (!current_tool || !current_tool->supportsSoftness()) return;
+    bool on = gtk_toggle_button_get_active(btn);
+    change_tool([on](Tool& t){t.setAntialias(on);});
+    gtk_widget_set_sensitive(hardness_slider, on && current_tool->supportsHardness());
+}
+
+static void 
+on_hardness_changed(GtkRange* range, gpointer){
+    if (!current_tool || !current_tool->supportsHardness()) return;
+    int hardness = static_cast<int>(gtk_range_get_value(range));
+    change_tool([hardness](Tool& t){t.setHardness(hardness);});
 }
 
 void 
 on_toggle_theme(GtkWidget*, gpointer){
     current_theme = (current_theme == &THEME_LIGHT) ? &THEME_DARK : &THEME_LIGHT;
     apply_theme_css(area, current_theme);
+    gtk_widget_queue_draw(area);
 }
 
 //---------------main--------------
 int 
 main(int argc, char** argv){
+    if (argc > 1 && std::strcmp(argv[1], "--memory-report") == 0)
+        return run_memory_report(argc, argv);
+
     gtk_init(&argc, &argv);
-    
+    board_mode = argc > 1 && std::strcmp(argv[1], "--board") == 0;
+
+    //PAINT_TRACE=file.json records a Chrome trace of the session (PROFILE=1 builds)
+    const char* tracePath = g_getenv("PAINT_TRACE");
+    if (tracePath) TRACE_START(tracePath);
 
     GtkWidget* window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(window), "Paint C++");
@@ -364,8 +1200,18 @@ main(int argc, char** argv){
     gtk_box_pack_start(GTK_BOX(root), area, TRUE, TRUE, 0);
     gtk_container_add(GTK_CONTAINER(window), root);
 
-    canvas = std::make_unique<Canvas>(800, 600);
-    canvas->clear(current_theme->background);
+    //frames are published on the render thread, redraws are requested on the main loop
+    static std::atomic<bool> redraw_pending{false};
+    renderer = std::make_unique<Renderer>(
+        std::make_unique<LayerStack>(800, 600, current_theme->background, board_mode),
+        apply_input,
+        []{
+            if (redraw_pending.exchange(true)) return;
+            runOnMainLoop([]{
+                redraw_pending = false;
+                gtk_widget_queue_draw(area);
+            });
+        });
 
     apply_theme_css(window, current_theme);
     
@@ -376,22 +1222,90 @@ main(int argc, char** argv){
     gtk_widget_set_sensitive(size_slider, FALSE);
     gtk_widget_set_hexpand(size_slider, TRUE);
 
+    tolerance_slider = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0, 255, 1);
+    gtk_scale_set_draw_value(GTK_SCALE(tolerance_slider), TRUE);
+    gtk_widget_set_sensitive(tolerance_slider, FALSE);
+    gtk_widget_set_hexpand(tolerance_slider, TRUE);
+
+    hardness_slider = gtk_scale_new_with_range(GTK_ORIENTATION_HORIZONTAL, 0, 100, 5);
+    gtk_scale_set_draw_value(GTK_SCALE(hardness_slider), TRUE);
+    gtk_widget_set_sensitive(hardness_slider, FALSE);
+    gtk_widget_set_hexpand(hardness_slider, TRUE);
+
     GtkWidget* btn_brush  = gtk_button_new_with_label("Brush");
     GtkWidget* btn_eraser = gtk_button_new_with_label("Eraser");
     GtkWidget* btn_fill   = gtk_button_new_with_label("Fill");
+    GtkWidget* btn_select = gtk_button_new_with_label("Select");
+    GtkWidget* btn_lasso  = gtk_button_new_with_label("Lasso");
+    GtkWidget* btn_wand   = gtk_button_new_with_label("Wand");
+    GtkWidget* btn_line   = gtk_button_new_with_label("Line");
+    GtkWidget* btn_rect   = gtk_button_new_with_label("Rectangle");
+    GtkWidget* btn_ellipse = gtk_button_new_with_label("Ellipse");
+    GtkWidget* btn_polygon = gtk_button_new_with_label("Polygon");
+    GtkWidget* btn_gradient = gtk_button_new_with_label("Gradient");
+    GtkWidget* btn_radial = gtk_button_new_with_label("Radial");
+    GtkWidget* btn_smudge = gtk_button_new_with_label("Smudge");
+    GtkWidget* btn_soften = gtk_button_new_with_label("Soften");
+    GtkWidget* btn_clone  = gtk_button_new_with_label("Clone");
+    GtkWidget* btn_stamp  = gtk_button_new_with_label("Stamp");
+    GtkWidget* btn_pattern = gtk_button_new_with_label("Pattern");
     btn_undo = gtk_button_new_with_label("Undo");
     btn_redo = gtk_button_new_with_label("Redo");
+    btn_branch = gtk_button_new_with_label("Branch");
     GtkWidget* btn_save  = gtk_button_new_with_label("Save");
     GtkWidget* btn_theme = gtk_button_new_with_label("Theme");
+    GtkWidget* btn_blur  = gtk_button_new_with_label("Blur");
+    GtkWidget* btn_adjust = gtk_button_new_with_label("Adjust");
+    smooth_toggle = gtk_toggle_button_new_with_label("Smooth");
+
+    //entries follow the BlendMode enum order
+    blend_combo = gtk_combo_box_text_new();
+    for (BlendMode m : {BlendMode::Normal, BlendMode::Replace, BlendMode::Multiply, BlendMode::Screen, BlendMode::Erase})
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(blend_combo), blendModeName(m));
+    gtk_widget_set_sensitive(blend_combo, FALSE);
+
+    symmetry_combo = gtk_combo_box_text_new();
+    for (const char* name : {"No symmetry", "Mirror X", "Mirror Y", "Mirror X+Y"})
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(symmetry_combo), name);
+    for (int folds : SYMMETRY_FOLDS)
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(symmetry_combo), ("Radial " + std::to_string(folds)).c_str());
+    gtk_combo_box_set_active(GTK_COMBO_BOX(symmetry_combo), 0);
 
     gtk_box_pack_start(GTK_BOX(toolbar), btn_brush,  FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_eraser, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_fill,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_select, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_lasso,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_wand,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_line,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_rect,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_ellipse, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_polygon, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_gradient, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_radial, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_smudge, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_soften, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_clone,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_stamp,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_pattern, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_undo,   FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_redo,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_branch, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_save,   FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(toolbar), btn_theme,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_blur,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), btn_adjust, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), smooth_toggle, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), blend_combo, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(toolbar), symmetry_combo, FALSE, FALSE, 0);
     gtk_box_pack_end(GTK_BOX(toolbar), size_slider, FALSE, FALSE, 4);
+    gtk_box_pack_end(GTK_BOX(toolbar), tolerance_slider, FALSE, FALSE, 4);
+    gtk_box_pack_end(GTK_BOX(toolbar), hardness_slider, FALSE, FALSE, 4);
+
+    //only shown while a large fill runs
+    fill_progress = gtk_progress_bar_new();
+    gtk_widget_set_no_show_all(fill_progress, TRUE);
+    gtk_box_pack_end(GTK_BOX(toolbar), fill_progress, FALSE, FALSE, 4);
 
     GtkWidget* spacer = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
     gtk_widget_set_vexpand(spacer, TRUE);
@@ -420,19 +1334,49 @@ main(int argc, char** argv){
     g_signal_connect(btn_brush,  "clicked", G_CALLBACK(on_tool_brush), btn_brush);
     g_signal_connect(btn_eraser, "clicked", G_CALLBACK(on_tool_eraser), btn_eraser);
     g_signal_connect(btn_fill,   "clicked", G_CALLBACK(on_tool_fill), btn_fill);
+    g_signal_connect(btn_select, "clicked", G_CALLBACK(on_tool_select), btn_select);
+    g_signal_connect(btn_lasso,  "clicked", G_CALLBACK(on_tool_lasso), btn_lasso);
+    g_signal_connect(btn_wand,   "clicked", G_CALLBACK(on_tool_wand), btn_wand);
+    g_signal_connect(btn_line,   "clicked", G_CALLBACK(on_tool_line), btn_line);
+    g_signal_connect(btn_rect,   "clicked", G_CALLBACK(on_tool_rectangle), btn_rect);
+    g_signal_connect(btn_ellipse, "clicked", G_CALLBACK(on_tool_ellipse), btn_ellipse);
+    g_signal_connect(btn_polygon, "clicked", G_CALLBACK(on_tool_polygon), btn_polygon);
+    g_signal_connect(btn_gradient, "clicked", G_CALLBACK(on_tool_gradient), btn_gradient);
+    g_signal_connect(btn_radial, "clicked", G_CALLBACK(on_tool_radial), btn_radial);
+    g_signal_connect(btn_smudge, "clicked", G_CALLBACK(on_tool_smudge), btn_smudge);
+    g_signal_connect(btn_soften, "clicked", G_CALLBACK(on_tool_soften), btn_soften);
+    g_signal_connect(btn_clone,  "clicked", G_CALLBACK(on_tool_clone), btn_clone);
+    g_signal_connect(btn_stamp,  "clicked", G_CALLBACK(on_tool_stamp), btn_stamp);
+    g_signal_connect(btn_pattern, "clicked", G_CALLBACK(on_tool_pattern), btn_pattern);
     g_signal_connect(btn_undo,   "clicked", G_CALLBACK(on_undo), area);
     g_signal_connect(btn_redo,   "clicked", G_CALLBACK(on_redo), area);
+    g_signal_connect(btn_branch, "clicked", G_CALLBACK(on_branch), area);
     g_signal_connect(btn_save,   "clicked", G_CALLBACK(on_save), window);
     g_signal_connect(btn_theme,  "clicked", G_CALLBACK(on_toggle_theme), window);
+    g_signal_connect(btn_blur,   "clicked", G_CALLBACK(on_blur), window);
+    g_signal_connect(btn_adjust, "clicked", G_CALLBACK(on_adjust), window);
 
     g_signal_connect(color_button, "color-set", G_CALLBACK(on_color_changed), nullptr);
     g_signal_connect(size_slider, "value-changed", G_CALLBACK(on_size_changed), nullptr);
+    g_signal_connect(tolerance_slider, "value-changed", G_CALLBACK(on_tolerance_changed), nullptr);
+    g_signal_connect(hardness_slider, "value-changed", G_CALLBACK(on_hardness_changed), nullptr);
+    g_signal_connect(smooth_toggle, "toggled", G_CALLBACK(on_smooth_toggled), nullptr);
+    g_signal_connect(blend_combo, "changed", G_CALLBACK(on_blend_changed), nullptr);
+    g_signal_connect(symmetry_combo, "changed", G_CALLBACK(on_symmetry_changed), nullptr);
 
     update_color_button();
     update_size_slider();
-    update_history_buttons();
+    update_tolerance_slider();
+    update_softness_widgets();
+    update_blend_combo();
+    renderer->sync([](LayerStack& l){layer_added(l, 0);});
     gtk_widget_show_all(window);
     gtk_main();
 
+    //commands reference the globals below, stop the render thread first
+    renderer.reset();
+    current_tool.reset();
+    TRACE_STOP();
+
     return 0;
 }